@@ -0,0 +1,765 @@
+#include <stdlib.h>
+#include <string.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+#include "batch.h"
+
+#define LANE_ALIGN 32
+#define MAX_GROUPS 8
+
+static void step_round(struct chip8_batch *);
+static uint32_t pending(const struct chip8_batch *, size_t);
+static size_t gather(struct chip8_batch *, uint16_t, size_t, size_t);
+static bool execute(struct chip8_batch *, size_t, size_t, size_t);
+static bool same_op(const struct chip8_batch *, size_t, size_t, size_t);
+static void fallback(struct chip8_batch *, size_t, size_t);
+static void fault(struct chip8_batch *, size_t, enum chip8_status);
+static void sync_in(struct chip8_batch *, size_t);
+static void sync_out(struct chip8_batch *, size_t);
+static void mark_writes(struct chip8_batch *, size_t);
+static void load8(uint8_t *, const uint8_t *, uint8_t, const uint8_t *,
+    size_t, size_t);
+static void load16(uint16_t *, uint16_t, const uint8_t *, size_t, size_t);
+static void add8(uint8_t *, uint8_t, const uint8_t *, size_t, size_t);
+static void alu(uint8_t *, const uint8_t *, const uint8_t *, uint8_t *,
+    uint8_t, const uint8_t *, size_t, size_t);
+static void skip(uint16_t *, const uint8_t *, const uint8_t *, uint8_t,
+    bool, const uint8_t *, size_t, size_t);
+
+struct chip8_batch *chip8_batch_create(size_t n)
+{
+    if (!n) {
+        return NULL;
+    }
+    struct chip8_batch *b = calloc(1, sizeof(*b));
+    if (!b) {
+        return NULL;
+    }
+    b->n = n;
+    b->stride = (n + LANE_ALIGN - 1) / LANE_ALIGN * LANE_ALIGN;
+    size_t sz = b->stride * (CHIP8_NUMREGS + 2 * sizeof(uint16_t) + 4);
+    b->soa = aligned_alloc(LANE_ALIGN, sz);
+    b->lanes = calloc(n, sizeof(*b->lanes));
+    if (!b->soa || !b->lanes) {
+        chip8_batch_destroy(b);
+        return NULL;
+    }
+    memset(b->soa, 0, sz);
+    uint8_t *p = b->soa;
+    for (size_t r = 0; r < CHIP8_NUMREGS; ++r, p += b->stride) {
+        b->v[r] = p;
+    }
+    b->i = (uint16_t *)p;
+    p += b->stride * sizeof(uint16_t);
+    b->pc = (uint16_t *)p;
+    p += b->stride * sizeof(uint16_t);
+    b->delay = p;
+    p += b->stride;
+    b->ok = p;
+    p += b->stride;
+    b->pend = p;
+    p += b->stride;
+    b->mask = p;
+
+    for (size_t l = 0; l < n; ++l) {
+        if (!(b->lanes[l] = chip8_create(NULL))) {
+            chip8_batch_destroy(b);
+            return NULL;
+        }
+    }
+    b->cycles_per_frame = CHIP8_DEFAULT_CYCLES;
+    chip8_batch_reset(b, CHIP8_DEFAULT_ENTRY);
+    return b;
+}
+
+void chip8_batch_destroy(struct chip8_batch *b)
+{
+    if (b->lanes) {
+        for (size_t l = 0; l < b->n; ++l) {
+            if (b->lanes[l]) {
+                chip8_destroy(b->lanes[l]);
+            }
+        }
+    }
+    free(b->lanes);
+    free(b->soa);
+    free(b);
+}
+
+void chip8_batch_reset(struct chip8_batch *b, uint16_t entry)
+{
+    for (size_t l = 0; l < b->n; ++l) {
+        chip8_reset(b->lanes[l], entry);
+        sync_out(b, l);
+    }
+    memset(b->written, 0, sizeof(b->written));
+    b->running = b->n;
+}
+
+bool chip8_batch_load(struct chip8_batch *b, uint16_t offset,
+    uint8_t const img[], size_t num)
+{
+    for (size_t l = 0; l < b->n; ++l) {
+        if (!chip8_load(b->lanes[l], offset, img, num)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void chip8_batch_set_profile(struct chip8_batch *b,
+    const struct chip8_profile *prof)
+{
+    for (size_t l = 0; l < b->n; ++l) {
+        chip8_set_profile(b->lanes[l], prof);
+    }
+    b->quirks = b->lanes[0]->quirks;
+    b->cycles_per_frame = b->lanes[0]->cycles_per_frame;
+}
+
+void chip8_batch_seed(struct chip8_batch *b, size_t lane, uint32_t seed)
+{
+    chip8_seed(b->lanes[lane], seed);
+}
+
+size_t chip8_batch_step(struct chip8_batch *b, size_t n)
+{
+    for (; n && b->running; --n) {
+        step_round(b);
+    }
+    return b->running;
+}
+
+size_t chip8_batch_run_frame(struct chip8_batch *b)
+{
+    chip8_batch_step(b, b->cycles_per_frame);
+    for (size_t l = 0; l < b->stride; ++l) {
+        b->delay[l] -= (b->delay[l]) ? 1 : 0;
+    }
+    for (size_t l = 0; l < b->n; ++l) {
+        b->lanes[l]->sound -= (b->lanes[l]->sound) ? 1 : 0;
+    }
+    return b->running;
+}
+
+void chip8_batch_set_key(struct chip8_batch *b, size_t lane, uint8_t key,
+    bool down)
+{
+    bool was_ok = b->ok[lane];
+    sync_in(b, lane);
+    chip8_set_key(b->lanes[lane], key, down);
+    sync_out(b, lane);
+    b->running += b->ok[lane] - was_ok;
+}
+
+const struct chip8 *chip8_batch_lane(struct chip8_batch *b, size_t lane)
+{
+    sync_in(b, lane);
+    return b->lanes[lane];
+}
+
+/*
+    Executes one cycle on every running lane. Lanes are grouped by pc:
+    the first pending lane leads a group, which takes in every pending
+    lane at the same pc, and the leader's instruction is executed once
+    for the whole group under its lane mask. Only the first MAX_GROUPS
+    groups of a round look across every lane; after that a group only
+    takes in lanes from its leader's block of LANE_ALIGN, so a batch
+    which has diverged completely costs a few vector operations per
+    lane rather than a pass over the whole batch per lane.
+*/
+static void step_round(struct chip8_batch *b)
+{
+    size_t groups = 0;
+#ifdef __AVX2__
+    for (size_t l = 0; l < b->stride; l += LANE_ALIGN) {
+        __m256i ok = _mm256_load_si256((const __m256i *)&b->ok[l]);
+        _mm256_store_si256((__m256i *)&b->pend[l],
+            _mm256_sub_epi8(_mm256_setzero_si256(), ok));
+    }
+#else
+    for (size_t l = 0; l < b->stride; ++l) {
+        b->pend[l] = -b->ok[l];
+    }
+#endif
+    for (size_t from = 0; from < b->stride; from += LANE_ALIGN) {
+        uint32_t bits = 0;
+        while ((bits = pending(b, from))) {
+            size_t l = from + __builtin_ctz(bits);
+            size_t to = (groups < MAX_GROUPS) ?
+                b->stride : from + LANE_ALIGN;
+            size_t count = gather(b, b->pc[l], from, to);
+            ++groups;
+            b->cycles += count;
+            if (execute(b, l, from, to)) {
+                b->vector_cycles += count;
+            } else {
+                fallback(b, from, to);
+            }
+        }
+    }
+}
+
+/* one bit per pending lane in the block of LANE_ALIGN at from */
+static uint32_t pending(const struct chip8_batch *b, size_t from)
+{
+#ifdef __AVX2__
+    return _mm256_movemask_epi8(
+        _mm256_load_si256((const __m256i *)&b->pend[from])
+    );
+#else
+    uint32_t bits = 0;
+    for (size_t l = 0; l < LANE_ALIGN; ++l) {
+        bits |= (uint32_t)(b->pend[from + l] & 1) << l;
+    }
+    return bits;
+#endif
+}
+
+/*
+    Moves the pending lanes in [from, to) whose pc is pc from pend into
+    mask and returns how many there were.
+*/
+static size_t gather(struct chip8_batch *b, uint16_t pc, size_t from,
+    size_t to)
+{
+    size_t count = 0;
+#ifdef __AVX2__
+    const __m256i want = _mm256_set1_epi16(pc);
+    for (size_t l = from; l < to; l += LANE_ALIGN) {
+        __m256i lo = _mm256_cmpeq_epi16(
+            _mm256_load_si256((const __m256i *)&b->pc[l]),
+            want
+        );
+        __m256i hi = _mm256_cmpeq_epi16(
+            _mm256_load_si256((const __m256i *)&b->pc[l + LANE_ALIGN / 2]),
+            want
+        );
+        // packs interleaves the 128-bit halves, so put them back in order
+        __m256i eq = _mm256_permute4x64_epi64(
+            _mm256_packs_epi16(lo, hi),
+            0xd8
+        );
+        __m256i p = _mm256_load_si256((const __m256i *)&b->pend[l]);
+        __m256i m = _mm256_and_si256(eq, p);
+        _mm256_store_si256((__m256i *)&b->mask[l], m);
+        _mm256_store_si256((__m256i *)&b->pend[l], _mm256_andnot_si256(m, p));
+        count += __builtin_popcount(_mm256_movemask_epi8(m));
+    }
+#else
+    for (size_t l = from; l < to; ++l) {
+        uint8_t m = b->pend[l] & -(b->pc[l] == pc);
+        b->mask[l] = m;
+        b->pend[l] &= ~m;
+        count += m & 1;
+    }
+#endif
+    return count;
+}
+
+/*
+    Executes the instruction at the leader's pc on every lane in mask,
+    working directly on the struct-of-arrays registers. Instructions
+    which only touch a lane's stack, keys, sound timer or framebuffer
+    are done lane by lane in place. Returns false, having done nothing,
+    if the group must be stepped through chip8_step instead.
+*/
+static bool execute(struct chip8_batch *b, size_t leader, size_t from,
+    size_t to)
+{
+    uint16_t pc = b->pc[leader];
+    if (pc >= CHIP8_MEM_SZ - 2) {
+        return false;
+    }
+    uint8_t op_hi = b->lanes[leader]->mem[pc];
+    uint8_t op_lo = b->lanes[leader]->mem[pc + 1];
+    if ((b->written[pc] || b->written[pc + 1])
+        && !same_op(b, pc, from, to)) {
+        return false;
+    }
+    uint16_t op_addr = ((op_hi & 0x0f) << 8) + op_lo;
+    uint8_t *vx = b->v[op_hi & 0x0f];
+    uint8_t *vy = b->v[op_lo >> 4];
+    uint8_t *vf = b->v[0xf];
+    const uint8_t *m = b->mask;
+    uint16_t next = pc + 2;
+
+    switch (op_hi >> 4) {
+        case 0x0:
+            switch (op_lo) {
+                case 0xe0: //CLS
+                    for (size_t l = from; l < to; ++l) {
+                        if (m[l]) {
+                            memset(b->lanes[l]->vmem, 0,
+                                sizeof(b->lanes[l]->vmem));
+                            b->lanes[l]->dirty = true;
+                        }
+                    }
+                    break;
+                case 0xee: //RET
+                    for (size_t l = from; l < to; ++l) {
+                        if (!m[l]) {
+                            continue;
+                        }
+                        struct chip8 *vm = b->lanes[l];
+                        if (vm->sp <= 0) {
+                            fault(b, l, CHIP8_ESTACK);
+                            continue;
+                        }
+                        --vm->sp;
+                        b->pc[l] = vm->stack[vm->sp] + 2;
+                    }
+                    return true;
+                default:
+                    return false;
+            }
+            break;
+        case 0x1: //JP
+            next = op_addr;
+            break;
+        case 0x2: //CALL
+            for (size_t l = from; l < to; ++l) {
+                if (!m[l]) {
+                    continue;
+                }
+                struct chip8 *vm = b->lanes[l];
+                if (vm->sp >= CHIP8_STACK_SZ) {
+                    fault(b, l, CHIP8_ESTACK);
+                    continue;
+                }
+                vm->stack[vm->sp] = pc;
+                ++vm->sp;
+                b->pc[l] = op_addr;
+            }
+            return true;
+        case 0x3: //SE
+            skip(b->pc, vx, NULL, op_lo, true, m, from, to);
+            return true;
+        case 0x4: //SNE
+            skip(b->pc, vx, NULL, op_lo, false, m, from, to);
+            return true;
+        case 0x5: //SRE
+            skip(b->pc, vx, vy, 0, true, m, from, to);
+            return true;
+        case 0x6: //LD
+            load8(vx, NULL, op_lo, m, from, to);
+            break;
+        case 0x7: //ADD
+            add8(vx, op_lo, m, from, to);
+            break;
+        case 0x8:
+            {
+                uint8_t op = op_lo & 0x0f;
+                bool shift = op == 0x6 || op == 0xe;
+                if (op > 0x7 && op != 0xe) {
+                    return false;
+                }
+                if (shift && (b->quirks & CHIP8_QUIRK_SHIFT_VY)) {
+                    alu(vx, vy, vy, vf, op, m, from, to);
+                } else {
+                    alu(vx, vx, vy, vf, op, m, from, to);
+                }
+            }
+            break;
+        case 0x9: //SRNE
+            skip(b->pc, vx, vy, 0, false, m, from, to);
+            return true;
+        case 0xa: //LDI
+            load16(b->i, op_addr, m, from, to);
+            break;
+        case 0xb: //JMPI
+            {
+                const uint8_t *base = (b->quirks & CHIP8_QUIRK_JUMP_VX) ?
+                    vx : b->v[0];
+                for (size_t l = from; l < to; ++l) {
+                    if (m[l]) {
+                        b->pc[l] = op_addr + base[l];
+                    }
+                }
+            }
+            return true;
+        case 0xe:
+            if (op_lo != 0x9e && op_lo != 0xa1) {
+                return false;
+            }
+            for (size_t l = from; l < to; ++l) {
+                if (m[l]) {
+                    bool down = b->lanes[l]->keys & 1 << (vx[l] & 0x0f);
+                    b->pc[l] += (down == (op_lo == 0x9e)) ? 4 : 2;
+                }
+            }
+            return true;
+        case 0xf:
+            switch (op_lo) {
+                case 0x07: //MVD
+                    load8(vx, b->delay, 0, m, from, to);
+                    break;
+                case 0x15: //LDD
+                    load8(b->delay, vx, 0, m, from, to);
+                    break;
+                case 0x18: //LDS
+                    for (size_t l = from; l < to; ++l) {
+                        if (m[l]) {
+                            b->lanes[l]->sound = vx[l];
+                        }
+                    }
+                    break;
+                case 0x1e: //ADDI
+                    for (size_t l = from; l < to; ++l) {
+                        if (m[l]) {
+                            vf[l] = (b->i[l] + vx[l] > 0xfff) ? 0x1 : 0x0;
+                            b->i[l] += vx[l];
+                        }
+                    }
+                    break;
+                case 0x29: //LDSP
+                    for (size_t l = from; l < to; ++l) {
+                        if (m[l]) {
+                            b->i[l] = CHIP8_MEM_SZ + (vx[l] & 0x0f) * 5;
+                        }
+                    }
+                    break;
+                default:
+                    return false;
+            }
+            break;
+        default:
+            return false;
+    }
+    load16(b->pc, next, m, from, to);
+    return true;
+}
+
+/*
+    Lanes are loaded with identical memory, so opcodes only have to be
+    compared across the group at addresses some lane may have written
+    to since.
+*/
+static bool same_op(const struct chip8_batch *b, size_t pc, size_t from,
+    size_t to)
+{
+    const uint8_t *op = NULL;
+    for (size_t l = from; l < to; ++l) {
+        if (!b->mask[l]) {
+            continue;
+        }
+        if (!op) {
+            op = &b->lanes[l]->mem[pc];
+        } else if (memcmp(op, &b->lanes[l]->mem[pc], 2) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+    Steps each lane in mask on its own through chip8_step. Only the
+    registers of those lanes are synced, and only for the instructions
+    (draws, memory access, fx0a, random numbers and faults) which
+    execute can't do in place.
+*/
+static void fallback(struct chip8_batch *b, size_t from, size_t to)
+{
+    for (size_t l = from; l < to; ++l) {
+        if (!b->mask[l]) {
+            continue;
+        }
+        sync_in(b, l);
+        mark_writes(b, l);
+        chip8_step(b->lanes[l], 1);
+        sync_out(b, l);
+        b->running -= !b->ok[l];
+    }
+}
+
+/* leaves pc on the offending instruction, as chip8_step does */
+static void fault(struct chip8_batch *b, size_t lane,
+    enum chip8_status status)
+{
+    b->lanes[lane]->status = status;
+    b->ok[lane] = 0;
+    --b->running;
+}
+
+static void sync_in(struct chip8_batch *b, size_t lane)
+{
+    struct chip8 *vm = b->lanes[lane];
+    for (size_t r = 0; r < CHIP8_NUMREGS; ++r) {
+        vm->v[r] = b->v[r][lane];
+    }
+    vm->i = b->i[lane];
+    vm->pc = b->pc[lane];
+    vm->delay = b->delay[lane];
+}
+
+static void sync_out(struct chip8_batch *b, size_t lane)
+{
+    struct chip8 *vm = b->lanes[lane];
+    for (size_t r = 0; r < CHIP8_NUMREGS; ++r) {
+        b->v[r][lane] = vm->v[r];
+    }
+    b->i[lane] = vm->i;
+    b->pc[lane] = vm->pc;
+    b->delay[lane] = vm->delay;
+    b->ok[lane] = vm->status == CHIP8_OK;
+}
+
+/* records the addresses fx33 and fx55 are about to write, see same_op */
+static void mark_writes(struct chip8_batch *b, size_t lane)
+{
+    struct chip8 *vm = b->lanes[lane];
+    if (vm->pc >= CHIP8_MEM_SZ - 2) {
+        return;
+    }
+    uint8_t op_hi = vm->mem[vm->pc];
+    uint8_t op_lo = vm->mem[vm->pc + 1];
+    size_t num = 0;
+    if (op_hi >> 4 != 0xf) {
+        return;
+    }
+    if (op_lo == 0x33) {
+        num = 3;
+    } else if (op_lo == 0x55) {
+        num = (op_hi & 0x0f) + 1;
+    }
+    for (size_t a = vm->i; a < vm->i + num && a < CHIP8_MEM_SZ; ++a) {
+        b->written[a] = 1;
+    }
+}
+
+/*
+    The helpers below all work on the lanes in [from, to), which is
+    always whole blocks of LANE_ALIGN, and leave lanes outside mask
+    untouched. load8 sets dst to src, or to imm if src is NULL.
+*/
+static void load8(uint8_t *dst, uint8_t const *src, uint8_t imm,
+    uint8_t const *mask, size_t from, size_t to)
+{
+#ifdef __AVX2__
+    const __m256i val = _mm256_set1_epi8(imm);
+    for (size_t l = from; l < to; l += LANE_ALIGN) {
+        __m256i k = _mm256_load_si256((const __m256i *)&mask[l]);
+        __m256i d = _mm256_load_si256((const __m256i *)&dst[l]);
+        __m256i s = (src) ? _mm256_load_si256((const __m256i *)&src[l]) : val;
+        _mm256_store_si256((__m256i *)&dst[l], _mm256_blendv_epi8(d, s, k));
+    }
+#else
+    for (size_t l = from; l < to; ++l) {
+        if (mask[l]) {
+            dst[l] = (src) ? src[l] : imm;
+        }
+    }
+#endif
+}
+
+static void load16(uint16_t *dst, uint16_t imm, uint8_t const *mask,
+    size_t from, size_t to)
+{
+#ifdef __AVX2__
+    const __m256i val = _mm256_set1_epi16(imm);
+    for (size_t l = from; l < to; l += LANE_ALIGN) {
+        __m256i k = _mm256_load_si256((const __m256i *)&mask[l]);
+        __m256i k_lo = _mm256_cvtepi8_epi16(_mm256_castsi256_si128(k));
+        __m256i k_hi = _mm256_cvtepi8_epi16(_mm256_extracti128_si256(k, 1));
+        __m256i *p_lo = (__m256i *)&dst[l];
+        __m256i *p_hi = (__m256i *)&dst[l + LANE_ALIGN / 2];
+        _mm256_store_si256(p_lo,
+            _mm256_blendv_epi8(_mm256_load_si256(p_lo), val, k_lo));
+        _mm256_store_si256(p_hi,
+            _mm256_blendv_epi8(_mm256_load_si256(p_hi), val, k_hi));
+    }
+#else
+    for (size_t l = from; l < to; ++l) {
+        if (mask[l]) {
+            dst[l] = imm;
+        }
+    }
+#endif
+}
+
+static void add8(uint8_t *dst, uint8_t nn, uint8_t const *mask, size_t from,
+    size_t to)
+{
+#ifdef __AVX2__
+    const __m256i val = _mm256_set1_epi8(nn);
+    for (size_t l = from; l < to; l += LANE_ALIGN) {
+        __m256i k = _mm256_load_si256((const __m256i *)&mask[l]);
+        __m256i d = _mm256_load_si256((const __m256i *)&dst[l]);
+        _mm256_store_si256((__m256i *)&dst[l],
+            _mm256_add_epi8(d, _mm256_and_si256(val, k)));
+    }
+#else
+    for (size_t l = from; l < to; ++l) {
+        dst[l] += nn & mask[l];
+    }
+#endif
+}
+
+/*
+    8xy_ with the same vf semantics as chip8.c: the flag is stored
+    after dst. vx is the operand shifted by 8xy6/8xye, which the caller
+    points at vy under CHIP8_QUIRK_SHIFT_VY.
+*/
+static void alu(uint8_t *dst, uint8_t const *vx, uint8_t const *vy,
+    uint8_t *vf, uint8_t op, uint8_t const *mask, size_t from, size_t to)
+{
+#ifdef __AVX2__
+    const __m256i one = _mm256_set1_epi8(1);
+    for (size_t l = from; l < to; l += LANE_ALIGN) {
+        __m256i k = _mm256_load_si256((const __m256i *)&mask[l]);
+        __m256i d = _mm256_load_si256((const __m256i *)&dst[l]);
+        __m256i x = _mm256_load_si256((const __m256i *)&vx[l]);
+        __m256i y = _mm256_load_si256((const __m256i *)&vy[l]);
+        __m256i r = x;
+        __m256i f = x;
+        bool flag = true;
+        switch (op) {
+            case 0x0:
+                r = y;
+                flag = false;
+                break;
+            case 0x1:
+                r = _mm256_or_si256(x, y);
+                flag = false;
+                break;
+            case 0x2:
+                r = _mm256_and_si256(x, y);
+                flag = false;
+                break;
+            case 0x3:
+                r = _mm256_xor_si256(x, y);
+                flag = false;
+                break;
+            case 0x4:
+                // carry iff the sum wrapped below x
+                r = _mm256_add_epi8(x, y);
+                f = _mm256_andnot_si256(
+                    _mm256_cmpeq_epi8(_mm256_max_epu8(r, x), r),
+                    one
+                );
+                break;
+            case 0x5:
+                r = _mm256_sub_epi8(x, y);
+                f = _mm256_and_si256(
+                    _mm256_cmpeq_epi8(_mm256_max_epu8(x, y), x),
+                    one
+                );
+                break;
+            case 0x6:
+                r = _mm256_and_si256(
+                    _mm256_srli_epi16(x, 1),
+                    _mm256_set1_epi8(0x7f)
+                );
+                f = _mm256_and_si256(x, one);
+                break;
+            case 0x7:
+                r = _mm256_sub_epi8(y, x);
+                f = _mm256_and_si256(
+                    _mm256_cmpeq_epi8(_mm256_max_epu8(y, x), y),
+                    one
+                );
+                break;
+            case 0xe:
+                r = _mm256_add_epi8(x, x);
+                f = _mm256_and_si256(_mm256_srli_epi16(x, 7), one);
+                break;
+        }
+        _mm256_store_si256((__m256i *)&dst[l], _mm256_blendv_epi8(d, r, k));
+        if (flag) {
+            __m256i g = _mm256_load_si256((const __m256i *)&vf[l]);
+            _mm256_store_si256((__m256i *)&vf[l], _mm256_blendv_epi8(g, f, k));
+        }
+    }
+#else
+    for (size_t l = from; l < to; ++l) {
+        uint8_t x = vx[l];
+        uint8_t y = vy[l];
+        if (!mask[l]) {
+            continue;
+        }
+        switch (op) {
+            case 0x0:
+                dst[l] = y;
+                break;
+            case 0x1:
+                dst[l] = x | y;
+                break;
+            case 0x2:
+                dst[l] = x & y;
+                break;
+            case 0x3:
+                dst[l] = x ^ y;
+                break;
+            case 0x4:
+                dst[l] = x + y;
+                vf[l] = ((int)x + (int)y > 0xff) ? 0x1 : 0x0;
+                break;
+            case 0x5:
+                dst[l] = x - y;
+                vf[l] = (x >= y) ? 0x1 : 0x0;
+                break;
+            case 0x6:
+                dst[l] = x >> 1;
+                vf[l] = x & 0x01;
+                break;
+            case 0x7:
+                dst[l] = y - x;
+                vf[l] = (y >= x) ? 0x1 : 0x0;
+                break;
+            case 0xe:
+                dst[l] = x << 1;
+                vf[l] = (x & 0x80) >> 7;
+                break;
+        }
+    }
+#endif
+}
+
+/*
+    3xnn/4xnn (vy NULL) and 5xy0/9xy0: each lane's pc advances by 4
+    where the comparison against eq holds, else by 2.
+*/
+static void skip(uint16_t *pc, uint8_t const *vx, uint8_t const *vy,
+    uint8_t nn, bool eq, uint8_t const *mask, size_t from, size_t to)
+{
+#ifdef __AVX2__
+    const __m256i two = _mm256_set1_epi16(2);
+    const __m256i imm = _mm256_set1_epi8(nn);
+    const __m256i inv = (eq) ? _mm256_setzero_si256() :
+        _mm256_set1_epi8(-1);
+    for (size_t l = from; l < to; l += LANE_ALIGN) {
+        __m256i k = _mm256_load_si256((const __m256i *)&mask[l]);
+        __m256i x = _mm256_load_si256((const __m256i *)&vx[l]);
+        __m256i y = (vy) ? _mm256_load_si256((const __m256i *)&vy[l]) : imm;
+        __m256i m = _mm256_xor_si256(_mm256_cmpeq_epi8(x, y), inv);
+        __m256i m_lo = _mm256_cvtepi8_epi16(_mm256_castsi256_si128(m));
+        __m256i m_hi = _mm256_cvtepi8_epi16(_mm256_extracti128_si256(m, 1));
+        __m256i k_lo = _mm256_cvtepi8_epi16(_mm256_castsi256_si128(k));
+        __m256i k_hi = _mm256_cvtepi8_epi16(_mm256_extracti128_si256(k, 1));
+        __m256i *p_lo = (__m256i *)&pc[l];
+        __m256i *p_hi = (__m256i *)&pc[l + LANE_ALIGN / 2];
+        _mm256_store_si256(p_lo, _mm256_add_epi16(
+            _mm256_load_si256(p_lo),
+            _mm256_and_si256(
+                _mm256_add_epi16(two, _mm256_and_si256(m_lo, two)),
+                k_lo
+            )
+        ));
+        _mm256_store_si256(p_hi, _mm256_add_epi16(
+            _mm256_load_si256(p_hi),
+            _mm256_and_si256(
+                _mm256_add_epi16(two, _mm256_and_si256(m_hi, two)),
+                k_hi
+            )
+        ));
+    }
+#else
+    for (size_t l = from; l < to; ++l) {
+        if (mask[l]) {
+            bool same = vx[l] == ((vy) ? vy[l] : nn);
+            pc[l] += (same == eq) ? 4 : 2;
+        }
+    }
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,72 @@
+/*
+    A batch steps N Chip8 machines running the same program in
+    lockstep, for hosts which explore many input streams at once.
+
+    Each lane is an ordinary struct chip8 which keeps its own memory,
+    framebuffer, stack, keypad, and sound timer, but the registers the
+    interpreter touches on almost every cycle (v0-vf, i, pc and the
+    delay timer) are stored struct-of-arrays, so that v[x][lane] for
+    all lanes is contiguous. Every cycle the running lanes are grouped
+    by pc, and the instruction at each group's pc is decoded once and
+    executed for the whole group under a lane mask, with AVX2 when the
+    compiler targets it. Lanes which diverge, say on their own keys,
+    simply form separate groups until they land on the same pc again.
+    Loads, arithmetic, skips (including key skips), jumps, calls and
+    returns, and i, delay and sound timer access all run in place on
+    the struct-of-arrays registers; only draws, other memory access,
+    fx0a and cxnn step the lanes concerned on their own through
+    chip8_step, syncing their registers around that one instruction.
+
+    Every lane shares the program loaded by chip8_batch_load and the
+    profile set by chip8_batch_set_profile, but has its own keys and
+    random number generator (see chip8_batch_seed). Parked or halted
+    lanes simply stop advancing without holding the others back;
+    chip8_batch_step and chip8_batch_run_frame return how many lanes
+    are still running.
+
+    cycles counts instructions executed across all lanes and
+    vector_cycles those executed in place rather than through
+    chip8_step.
+
+    chip8_batch_lane brings the lane's struct chip8 up to date with the
+    batch's register file and returns it for inspection; it must not be
+    stepped directly.
+*/
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "chip8.h"
+
+struct chip8_batch {
+    size_t n;
+    size_t stride;
+    size_t running;
+    struct chip8 **lanes;
+    uint8_t *ok;
+    uint8_t *pend;
+    uint8_t *mask;
+    uint8_t *v[CHIP8_NUMREGS];
+    uint16_t *i;
+    uint16_t *pc;
+    uint8_t *delay;
+    void *soa;
+    uint8_t written[CHIP8_MEM_SZ];
+    uint8_t quirks;
+    size_t cycles_per_frame;
+    uint64_t cycles;
+    uint64_t vector_cycles;
+};
+
+struct chip8_batch *chip8_batch_create(size_t);
+void chip8_batch_destroy(struct chip8_batch *);
+void chip8_batch_reset(struct chip8_batch *, uint16_t);
+bool chip8_batch_load(struct chip8_batch *, uint16_t, const uint8_t[], size_t);
+void chip8_batch_set_profile(struct chip8_batch *,
+    const struct chip8_profile *);
+void chip8_batch_seed(struct chip8_batch *, size_t, uint32_t);
+size_t chip8_batch_step(struct chip8_batch *, size_t);
+size_t chip8_batch_run_frame(struct chip8_batch *);
+void chip8_batch_set_key(struct chip8_batch *, size_t, uint8_t, bool);
+const struct chip8 *chip8_batch_lane(struct chip8_batch *, size_t);
\ No newline at end of file
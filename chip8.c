@@ -14,10 +14,10 @@
     8xy2    AND     vx  vy      vx = vx & vy
     8xy3    XOR     vx  vy      vx = vx ^ vy
     8xy4    ADDR    vx  vy  vf* vx += vy; vf = (carry) ? 1 : 0
-    8xy5    SUBY    vx  vy  vf* vx -= vy; vf = (carry) ? 1 : 0
-    8x_6    SHR     vx  vf*     vx >>= 1; vf = vx & 0x01
-    8xy7    SUBX    vx  vy  vf* vx = yv - vx; vf = (carry) ? 1 : 0
-    8x_e    SHL     vx  vf*     vx <<= 1; vf = (vx & 0x80) >> 7
+    8xy5    SUBY    vx  vy  vf* vx -= vy; vf = (borrow) ? 0 : 1
+    8xy6    SHR     vx  vf*     vx >>= 1; vf = old vx & 0x01
+    8xy7    SUBX    vx  vy  vf* vx = vy - vx; vf = (borrow) ? 0 : 1
+    8xye    SHL     vx  vf*     vx <<= 1; vf = (old vx & 0x80) >> 7
     9xy0    SRNE    vx  vy      Skip next inst if vx != vy
     annn    LDI     nnn i*      i = nnn
     bnnn    JMPI    nnn         pc = nnn + v0
@@ -27,7 +27,7 @@
     ex93    SKP     vx          Skip next instr if key in vx was pressed
     exa1    SKNP    vx          Skip next instr if key in vs wasn't pressed
     fx07    MVD     vx          Set vx to value of delay timer
-    fx0a    KEY     vx          vx = Halt and wait for keypress
+    fx0a    KEY     vx          vx = Park and wait for key release
     fx15    LDD     vx          Set delay timer to value in vx
     fx18    LDS     vx          Set sound timer to value in vx
     fx1e    ADDI    vx  i*      i += vx
@@ -41,17 +41,51 @@
     fx65    READ    x   i*      Load registers 0-x inclusive from memory
                                 starting at addr i
     * implicit operand
+
+    Several opcodes behave differently across Chip8 implementations and
+    the variant used is selected per machine with chip8_set_profile:
+    CHIP8_QUIRK_SHIFT_VY    8xy6/8xye shift vy (not vx) into vx
+    CHIP8_QUIRK_LOAD_INC_I  fx55/fx65 leave i pointing past vx
+    CHIP8_QUIRK_JUMP_VX     bxnn jumps to xnn + vx instead of v0
+    CHIP8_QUIRK_CLIP        sprites clip at the screen edge rather than
+                            wrapping around
+
+    Instructions that set vf as a flag do so after writing vx, so the
+    flag wins when x is f.
+
+    A few three-instruction sequences make up most of what typical
+    programs execute, so they are recognized the first time they are
+    decoded and thereafter run as a single superinstruction:
+    6xnn annn dxyn          sprite setup and draw
+    fx07 3xnn 1nnn          polling the delay timer
+    7xnn 3xnn 1nnn          counting loop
+    A superinstruction is only used when at least three cycles remain
+    in the current chip8_step, and always consumes exactly as many
+    cycles as the instructions it replaces actually execute (two when
+    the skip is taken), so fusion never changes what a program does
+    within a frame. Polling and counting loops which jump back onto
+    themselves keep iterating inside the one dispatch until they exit
+    or the cycle budget runs out. The recognized kind of every address
+    is cached in fuse[] and the cache is invalidated whenever memory is
+    written.
 */
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "chip8.h"
-#include "input.h"
-#include "screen.h"
-#include "timer.h"
-#include "util.h"
 
-#define NUMREGS 16
+#define SPRITE_W 8
+#define FRAME_HZ 60
+#define FUSE_LEN 3
+#define RNG_SEED 0x2545f491
+
+enum fuse_kind {
+    FUSE_UNKNOWN = 0,
+    FUSE_NONE,
+    FUSE_SPRITE,
+    FUSE_POLL,
+    FUSE_COUNT
+};
 
 /*
     The Chip8 standard fontset contains sprites corresponding to each
@@ -60,8 +94,7 @@
     is loaded into an address range beyond that which is normally
     available to programs.
 */
-#define FONTSET_SZ 80
-static const uint8_t fontset[FONTSET_SZ] = { 
+static const uint8_t fontset[CHIP8_FONTSET_SZ] = { 
   0xf0, 0x90, 0x90, 0x90, 0xf0, // 0
   0x20, 0x60, 0x20, 0x20, 0x70, // 1
   0xf0, 0x10, 0xf0, 0x80, 0xf0, // 2
@@ -80,257 +113,557 @@ static const uint8_t fontset[FONTSET_SZ] = {
   0xf0, 0x80, 0xf0, 0x80, 0x80  // F
 };
 
-static uint8_t Mem[CHIP8_MEM_SZ + FONTSET_SZ] = {0};
-static uint16_t Stack[CHIP8_STACK_SZ] = {0};
-static uint8_t V[NUMREGS] = {0};
-static uint16_t I = 0;
-static uint16_t Pc = 0;
-static size_t Sp = 0;
+static enum chip8_status execute(struct chip8 *);
+static size_t execute_fused(struct chip8 *, size_t);
+static uint8_t decode_fused(const uint8_t *);
+static void invalidate(struct chip8 *, size_t, size_t);
+static uint8_t draw(struct chip8 *, uint8_t, uint8_t, uint8_t);
+static uint8_t next_rand(struct chip8 *);
 
-void chip8_init(size_t scale) 
+struct chip8 *chip8_create(const struct chip8_callbacks *cb)
 {
-    chip8_reset();
-    memcpy(&Mem[CHIP8_MEM_SZ], fontset, FONTSET_SZ);
-    scale = (scale) ? scale : SCREEN_DEFAULT_SCALE;
-    screen_init(scale);
-    timer_init();
+    struct chip8 *vm = malloc(sizeof(*vm));
+    if (!vm) {
+        return NULL;
+    }
+    if (cb) {
+        vm->cb = *cb;
+    } else {
+        vm->cb = (struct chip8_callbacks){0};
+    }
+    vm->rng = RNG_SEED;
+    vm->cycles = 0;
+    vm->fused_cycles = 0;
+    vm->quirks = 0;
+    vm->cycles_per_frame = CHIP8_DEFAULT_CYCLES;
+    vm->clock_hz = 0;
+    vm->clock_frac = 0;
+    chip8_reset(vm, CHIP8_DEFAULT_ENTRY);
+    return vm;
 }
 
-void chip8_reset(void)
+void chip8_destroy(struct chip8 *vm) 
 {
-    for (size_t i = 0; i < CHIP8_MEM_SZ; ++i) {
-        Mem[i] = 0;
-    }
-    for (size_t i = 0; i < NUMREGS; ++i) {
-        V[i] = 0;
-    }
-    I = 0;
-    Pc = 0;
-    Sp = 0;
-    screen_cls();
+    free(vm);
 }
 
-void chip8_destroy(void) 
+void chip8_reset(struct chip8 *vm, uint16_t entry)
 {
-    screen_destroy();
+    memset(vm->mem, 0, CHIP8_MEM_SZ);
+    memcpy(&vm->mem[CHIP8_MEM_SZ], fontset, CHIP8_FONTSET_SZ);
+    memset(vm->fuse, FUSE_UNKNOWN, sizeof(vm->fuse));
+    memset(vm->vmem, 0, sizeof(vm->vmem));
+    memset(vm->stack, 0, sizeof(vm->stack));
+    memset(vm->v, 0, sizeof(vm->v));
+    vm->i = 0;
+    vm->pc = entry;
+    vm->sp = 0;
+    vm->delay = 0;
+    vm->sound = 0;
+    vm->keys = 0;
+    vm->wait_reg = 0;
+    vm->dirty = true;
+    vm->status = CHIP8_OK;
 }
 
-bool chip8_load(uint16_t offset, uint8_t const img[], size_t num)
+bool chip8_load(struct chip8 *vm, uint16_t offset, uint8_t const img[],
+    size_t num)
 {
-    if (offset + num >= CHIP8_MEM_SZ) {
+    if (offset + num > CHIP8_MEM_SZ) {
         return false;
     }
-    memcpy(Mem + offset, img, num);
+    memcpy(vm->mem + offset, img, num);
+    invalidate(vm, offset, num);
     return true;
 }
 
-void chip8_execute(uint16_t entry)
+void chip8_set_profile(struct chip8 *vm, const struct chip8_profile *prof)
 {
-    for (Pc = entry; Pc < CHIP8_MEM_SZ - 2; Pc += 2) {
-        timer_update();
-        input_update();
-        
-        uint8_t op_hi = Mem[Pc];
-        uint8_t op_lo = Mem[Pc + 1];
-        uint16_t op_addr = ((op_hi & 0x0f) << 8) + op_lo;
-        size_t op_x = op_hi & 0x0f;
-        size_t op_y = op_lo >> 4;
+    vm->quirks = prof->quirks;
+    vm->cycles_per_frame = (prof->cycles_per_frame) ?
+        prof->cycles_per_frame : CHIP8_DEFAULT_CYCLES;
+}
+
+void chip8_set_clock(struct chip8 *vm, uint32_t hz)
+{
+    vm->clock_hz = hz;
+    vm->clock_frac = 0;
+}
+
+void chip8_seed(struct chip8 *vm, uint32_t seed)
+{
+    vm->rng = (seed) ? seed : RNG_SEED;
+}
+
+enum chip8_status chip8_step(struct chip8 *vm, size_t n)
+{
+    while (n && vm->status == CHIP8_OK) {
+        size_t done = 0;
+#ifndef TRACE
+        if (n >= FUSE_LEN) {
+            done = execute_fused(vm, n);
+            vm->fused_cycles += done;
+        }
+#endif
+        if (!done) {
+            vm->status = execute(vm);
+            done = 1;
+        }
+        vm->cycles += done;
+        n -= done;
+    }
+    return vm->status;
+}
+
+enum chip8_status chip8_run_frame(struct chip8 *vm)
+{
+    size_t cycles = vm->cycles_per_frame;
+    if (vm->clock_hz) {
+        cycles = vm->clock_hz / FRAME_HZ;
+        vm->clock_frac += vm->clock_hz % FRAME_HZ;
+        if (vm->clock_frac >= FRAME_HZ) {
+            vm->clock_frac -= FRAME_HZ;
+            ++cycles;
+        }
+    }
+    chip8_step(vm, cycles);
+    vm->delay -= (vm->delay) ? 1 : 0;
+    if (vm->sound) {
+        --vm->sound;
+        if (!vm->sound && vm->cb.sound) {
+            vm->cb.sound(vm->cb.ctx, false);
+        }
+    }
+    if (vm->dirty && vm->cb.draw) {
+        vm->cb.draw(vm->cb.ctx, &vm->vmem[0][0]);
+    }
+    vm->dirty = false;
+    return vm->status;
+}
+
+const uint8_t *chip8_framebuffer(const struct chip8 *vm)
+{
+    return &vm->vmem[0][0];
+}
+
+void chip8_set_key(struct chip8 *vm, uint8_t key, bool down)
+{
+    if (key >= CHIP8_NUMKEYS) {
+        return;
+    }
+    if (down) {
+        vm->keys |= 1 << key;
+    } else {
+        vm->keys &= ~(1 << key);
+        if (vm->status == CHIP8_WAIT) {
+            vm->v[vm->wait_reg] = key;
+            vm->status = CHIP8_OK;
+        }
+    }
+}
+
+const char *chip8_strerror(enum chip8_status status)
+{
+    switch (status) {
+        case CHIP8_OK:
+            return "no error";
+        case CHIP8_WAIT:
+            return "waiting for key";
+        case CHIP8_HALT:
+            return "program counter left program memory";
+        case CHIP8_EOPCODE:
+            return "unrecognized opcode";
+        case CHIP8_ESTACK:
+            return "stack overflow or underflow";
+        case CHIP8_EMEM:
+            return "illegal memory access";
+    }
+    return "unknown error";
+}
+
+/*
+    Executes the instruction at pc. On failure pc is left pointing at
+    the offending instruction so that the host can report it. fx0a
+    completes immediately, leaving pc past it and the machine parked.
+*/
+static enum chip8_status execute(struct chip8 *vm)
+{
+    uint8_t *V = vm->v;
+    uint8_t *Mem = vm->mem;
+
+    if (vm->pc >= CHIP8_MEM_SZ - 2) {
+        return CHIP8_HALT;
+    }
+    uint8_t op_hi = Mem[vm->pc];
+    uint8_t op_lo = Mem[vm->pc + 1];
+    uint16_t op_addr = ((op_hi & 0x0f) << 8) + op_lo;
+    size_t op_x = op_hi & 0x0f;
+    size_t op_y = op_lo >> 4;
+    uint16_t next = vm->pc + 2;
 
 #ifdef TRACE
-        printf(
-            "%03x: (%02x %02x) -- %03x -- [%02x %02x %02x %02x %02x %02x "
-                "%02x %02x %02x %02x %02x %02x %02x %02x %02x %02x] "
-                "delay %d\n",
-            Pc, op_hi, op_lo, I, V[0], V[1], V[2], V[3], V[4],
-            V[5], V[6], V[7], V[8], V[9], V[10], V[11], V[12],
-            V[13], V[14], V[15], Delay
-        );
+    printf(
+        "%03x: (%02x %02x) -- %03x -- [%02x %02x %02x %02x %02x %02x "
+            "%02x %02x %02x %02x %02x %02x %02x %02x %02x %02x] "
+            "delay %d\n",
+        vm->pc, op_hi, op_lo, vm->i, V[0], V[1], V[2], V[3], V[4],
+        V[5], V[6], V[7], V[8], V[9], V[10], V[11], V[12],
+        V[13], V[14], V[15], vm->delay
+    );
 #endif
-        switch (op_hi >> 4) {
-            case 0x0:
-                switch (op_lo) {
-                    case 0xe0: //CLS
-                        screen_cls();
-                        break;
-                    case 0xee: //RET
-                        if (Sp <= 0) {
-                            FAIL("stack underflow");
-                        }
-                        --Sp;
-                        Pc = Stack[Sp];
-                        break;
-                    default:
-                        goto unrecognized;
-                        break;
-                }
-                break;
-            case 0x1: //JP
-                Pc = op_addr - 2;
-                break;
-            case 0x2: //CALL
-                if (Sp >= CHIP8_STACK_SZ) {
-                    FAIL("stack overflow");
-                }
-                Stack[Sp] = Pc;
-                ++Sp;
-                Pc = op_addr - 2;
-                break;
-            case 0x3: //SE
-                if (V[op_x] == op_lo) {
-                    Pc += 2;
-                }
-                break;
-            case 0x4: //SNE
-                if (V[op_x] != op_lo) {
-                    Pc += 2;
-                }
-                break;
-            case 0x5: //SRNE
-                if (V[op_x] == V[op_y]) {
-                    Pc += 2;
-                }
-                break;
-            case 0x6: //LD
-                V[op_x] = op_lo;
-                break;
-            case 0x7: //ADD
-                V[op_x] += op_lo;
-                break;
-            case 0x8:
+    switch (op_hi >> 4) {
+        case 0x0:
+            switch (op_lo) {
+                case 0xe0: //CLS
+                    memset(vm->vmem, 0, sizeof(vm->vmem));
+                    vm->dirty = true;
+                    break;
+                case 0xee: //RET
+                    if (vm->sp <= 0) {
+                        return CHIP8_ESTACK;
+                    }
+                    --vm->sp;
+                    next = vm->stack[vm->sp] + 2;
+                    break;
+                default:
+                    return CHIP8_EOPCODE;
+            }
+            break;
+        case 0x1: //JP
+            next = op_addr;
+            break;
+        case 0x2: //CALL
+            if (vm->sp >= CHIP8_STACK_SZ) {
+                return CHIP8_ESTACK;
+            }
+            vm->stack[vm->sp] = vm->pc;
+            ++vm->sp;
+            next = op_addr;
+            break;
+        case 0x3: //SE
+            if (V[op_x] == op_lo) {
+                next += 2;
+            }
+            break;
+        case 0x4: //SNE
+            if (V[op_x] != op_lo) {
+                next += 2;
+            }
+            break;
+        case 0x5: //SRE
+            if (V[op_x] == V[op_y]) {
+                next += 2;
+            }
+            break;
+        case 0x6: //LD
+            V[op_x] = op_lo;
+            break;
+        case 0x7: //ADD
+            V[op_x] += op_lo;
+            break;
+        case 0x8:
+            {
+                uint8_t vx = V[op_x];
+                uint8_t vy = V[op_y];
                 switch (op_lo & 0x0f) {
                     case 0x0: //RCPY
-                        V[op_x] = V[op_y];
+                        V[op_x] = vy;
                         break;
                     case 0x1: //OR
-                        V[op_x] |= V[op_y];
+                        V[op_x] = vx | vy;
                         break;
                     case 0x2: //AND
-                        V[op_x] &= V[op_y];
+                        V[op_x] = vx & vy;
                         break;
                     case 0x3: //XOR
-                        V[op_x] ^= V[op_y];
+                        V[op_x] = vx ^ vy;
                         break;
                     case 0x4: //ADDR
-                        V[0xf] = ((int)V[op_x] + (int)V[op_y] > 0xff) ? 
-                            0x1 : 0x0;
-                        V[op_x] = V[op_x] + V[op_y];
+                        V[op_x] = vx + vy;
+                        V[0xf] = ((int)vx + (int)vy > 0xff) ? 0x1 : 0x0;
                         break;
                     case 0x5: //SUBY
-                        V[0xf] = (V[op_x] > V[op_y]) ? 0x1 : 0x0;
-                        V[op_x] = V[op_x] - V[op_y];
+                        V[op_x] = vx - vy;
+                        V[0xf] = (vx >= vy) ? 0x1 : 0x0;
                         break;
                     case 0x6: //SHR
-                        V[0xf] = V[op_x] & 0xfe;
-                        V[op_x] >>= 1;
+                        if (vm->quirks & CHIP8_QUIRK_SHIFT_VY) {
+                            vx = vy;
+                        }
+                        V[op_x] = vx >> 1;
+                        V[0xf] = vx & 0x01;
                         break;
                     case 0x7: //SUBX
-                        V[0xf] = (V[op_y] > V[op_x]) ? 0x1 : 0x0;
-                        V[op_x] = V[op_y] - V[op_x];
+                        V[op_x] = vy - vx;
+                        V[0xf] = (vy >= vx) ? 0x1 : 0x0;
                         break;
                     case 0xe: //SHL
-                        V[0xf] = (V[op_x] & 0x80) >> 7;
-                        V[op_x] <<= 1;
+                        if (vm->quirks & CHIP8_QUIRK_SHIFT_VY) {
+                            vx = vy;
+                        }
+                        V[op_x] = vx << 1;
+                        V[0xf] = (vx & 0x80) >> 7;
                         break;
                     default:
-                        goto unrecognized;
-                        break;
+                        return CHIP8_EOPCODE;
                 }
-                break;
-            case 0x9: //SRNE
-                if (V[op_x] != V[op_y]) {
-                    Pc += 2;
+            }
+            break;
+        case 0x9: //SRNE
+            if (V[op_x] != V[op_y]) {
+                next += 2;
+            }
+            break;
+        case 0xa: //LDI
+            vm->i = op_addr;
+            break;
+        case 0xb: //JMPI
+            if (vm->quirks & CHIP8_QUIRK_JUMP_VX) {
+                next = op_addr + V[op_x];
+            } else {
+                next = op_addr + V[0];
+            }
+            break;
+        case 0xc: //RAND
+            V[op_x] = op_lo & next_rand(vm);
+            break;
+        case 0xd: //DRAW
+            if (vm->i + (op_lo & 0x0f) > sizeof(vm->mem)) {
+                return CHIP8_EMEM;
+            }
+            V[0xf] = draw(vm, V[op_x], V[op_y], op_lo & 0x0f);
+            break;
+        case 0xe:
+            switch (op_lo) {
+                case 0x9e: //SKP
+                    next += (vm->keys & 1 << (V[op_x] & 0x0f)) ? 2 : 0;
+                    break;
+                case 0xa1: //SKNP
+                    next += (vm->keys & 1 << (V[op_x] & 0x0f)) ? 0 : 2;
+                    break;
+                default:
+                    return CHIP8_EOPCODE;
+            }
+            break;
+        case 0xf:
+            switch (op_lo) {
+                case 0x07: //MVD
+                    V[op_x] = vm->delay;
+                    break;
+                case 0x0a: //KEY
+                    vm->wait_reg = op_x;
+                    vm->pc = next;
+                    if (vm->cb.key_wait) {
+                        vm->cb.key_wait(vm->cb.ctx);
+                    }
+                    return CHIP8_WAIT;
+                case 0x15: //LDD
+                    vm->delay = V[op_x];
+                    break;
+                case 0x18: //LDS
+                    if (!vm->sound != !V[op_x] && vm->cb.sound) {
+                        vm->cb.sound(vm->cb.ctx, V[op_x] != 0);
+                    }
+                    vm->sound = V[op_x];
+                    break;
+                case 0x1e: //ADDI
+                    V[0xf] = (vm->i + V[op_x] > 0xfff) ? 0x1 : 0x0;
+                    vm->i += V[op_x];
+                    break;
+                case 0x29: //LDSP
+                    vm->i = CHIP8_MEM_SZ + (V[op_x] & 0x0f) * 5;
+                    break;
+                case 0x33: //BCD
+                    if (vm->i > CHIP8_MEM_SZ - 3) {
+                        return CHIP8_EMEM;
+                    }
+                    {
+                        uint8_t res = V[op_x];
+                        Mem[vm->i] = res / 100;
+                        res %= 100;
+                        Mem[vm->i + 1] = res / 10;
+                        Mem[vm->i + 2] = res % 10;
+                    }
+                    invalidate(vm, vm->i, 3);
+                    break;
+                case 0x55: //STOR
+                    if (vm->i + op_x + 1 >= CHIP8_MEM_SZ) {
+                        return CHIP8_EMEM;
+                    }
+                    for (size_t i = 0; i <= op_x; ++i) {
+                        Mem[vm->i + i] = V[i];
+                    }
+                    invalidate(vm, vm->i, op_x + 1);
+                    if (vm->quirks & CHIP8_QUIRK_LOAD_INC_I) {
+                        vm->i += op_x + 1;
+                    }
+                    break;
+                case 0x65: //READ
+                    if (vm->i + op_x + 1 >= CHIP8_MEM_SZ) {
+                        return CHIP8_EMEM;
+                    }
+                    for (size_t i = 0; i <= op_x; ++i) {
+                        V[i] = Mem[vm->i + i];
+                    }
+                    if (vm->quirks & CHIP8_QUIRK_LOAD_INC_I) {
+                        vm->i += op_x + 1;
+                    }
+                    break;
+                default:
+                    return CHIP8_EOPCODE;
+            }
+            break;
+        default:
+            return CHIP8_EOPCODE;
+    }
+    vm->pc = next;
+    return CHIP8_OK;
+}
+
+/*
+    Runs the superinstruction at pc, if there is one, within a budget
+    of at least FUSE_LEN cycles and returns the number of cycles it
+    used, or 0 if the caller should execute a single instruction
+    instead. Anything that would fault is left to execute so that
+    errors are reported against the right instruction.
+*/
+static size_t execute_fused(struct chip8 *vm, size_t budget)
+{
+    uint16_t pc = vm->pc;
+    if (pc >= CHIP8_MEM_SZ - 2 * FUSE_LEN) {
+        return 0;
+    }
+    if (vm->fuse[pc] == FUSE_UNKNOWN) {
+        vm->fuse[pc] = decode_fused(&vm->mem[pc]);
+    }
+
+    uint8_t *V = vm->v;
+    uint8_t const *op = &vm->mem[pc];
+    size_t x = op[0] & 0x0f;
+    uint16_t target = ((op[4] & 0x0f) << 8) + op[5];
+    size_t used = FUSE_LEN;
+    switch (vm->fuse[pc]) {
+        case FUSE_SPRITE:
+            {
+                uint16_t i = ((op[2] & 0x0f) << 8) + op[3];
+                uint8_t h = op[5] & 0x0f;
+                if (i + h > sizeof(vm->mem)) {
+                    return 0;
                 }
-                break;
-            case 0xa: //LDI
-                I = op_addr;
-                break;
-            case 0xb: //JMPI
-                Pc = op_addr + V[0] - 2;
-            case 0xc: //RAND
-                V[op_x] = op_lo & (rand() % 0xff);
-                break;
-            case 0xd://DRAW
-                V[0x0f] = screen_draw(
-                    V[op_x],
-                    V[op_y],
-                    op_lo & 0x0f,
-                    &Mem[I]
-                );
-                break;
-            case 0xe:
-                switch (op_lo) {
-                    case 0x9e: //SKP
-                        Pc += (input_query(V[op_x])) ? 2 : 0;
-                        break;
-                    case 0xa1: //SKNP
-                        Pc += (input_query(V[op_x])) ? 0 : 2;
-                        break;
-                    default:
-                        goto unrecognized;
+                V[x] = op[1];
+                vm->i = i;
+                V[0xf] = draw(vm, V[op[4] & 0x0f], V[op[5] >> 4], h);
+                vm->pc = pc + 2 * FUSE_LEN;
+            }
+            break;
+        case FUSE_POLL:
+            V[x] = vm->delay;
+            if (V[x] == op[3]) {
+                // the skip means the jump is never executed
+                vm->pc = pc + 2 * FUSE_LEN;
+                used = FUSE_LEN - 1;
+            } else {
+                vm->pc = target;
+                if (target == pc) {
+                    // nothing changes until the timer ticks
+                    used = budget - budget % FUSE_LEN;
                 }
-                break;
-            case 0xf:
-                switch (op_lo) {
-                    case 0x07: //MVD
-                        V[op_x] = timer_get_delay();
-                        break;
-                    case 0x0a: //KEY
-                        V[op_x] = input_get_key();
-                        break;
-                    case 0x15: //LDD
-                        timer_set_delay(V[op_x]);
-                        break;
-                    case 0x18: //LDS
-                        timer_set_sound(V[op_x]);
-                        break;
-                    case 0x1e: //ADDI
-                        V[0xf] = (I + V[op_x] > 0xfff) ? 0x1 : 0x0;
-                        I += V[op_x];
-                        break;
-                    case 0x29: //LDSP
-                        I = CHIP8_MEM_SZ + V[op_x]*5;
-                        break;
-                    case 0x33: //BCD
-                        if (I > CHIP8_MEM_SZ - 3) {
-                            FAIL("BCD causes memory overflow");
-                        }
-                        {
-                            uint8_t res = V[op_x];
-                            Mem[I] = res / 100;
-                            res %= 100;
-                            Mem[I + 1] = res / 10;
-                            Mem[I + 2] = res % 10;
-                        }
-                            break;
-                    case 0x55: //STOR
-                        if (I + op_x + 1 >= CHIP8_MEM_SZ) {
-                            FAIL("REGD causes memory overflow");
-                        }
-                        for (size_t i = 0; i <= op_x; ++i) {
-                            Mem[I + i] = V[i];
-                        }
-                        break;
-                    case 0x65: //READ
-                        if (I + op_x + 1 >= CHIP8_MEM_SZ) {
-                            FAIL("REGL accesses illegal address");
-                        }
-                        for (size_t i = 0; i <= op_x; ++i) {
-                            V[i] = Mem[I + i];
-                        }
-                        break;
-                    default:
-                        goto unrecognized;
-                        break;
+            }
+            break;
+        case FUSE_COUNT:
+            for (;;) {
+                V[x] += op[1];
+                if (V[x] == op[3]) {
+                    vm->pc = pc + 2 * FUSE_LEN;
+                    --used;
+                    break;
                 }
+                vm->pc = target;
+                if (target != pc || budget - used < FUSE_LEN) {
+                    break;
+                }
+                used += FUSE_LEN;
+            }
+            break;
+        default:
+            return 0;
+    }
+    return used;
+}
+
+static uint8_t decode_fused(uint8_t const op[])
+{
+    uint8_t x = op[0] & 0x0f;
+    bool skip_x = (op[2] >> 4) == 0x3 && (op[2] & 0x0f) == x;
+    bool jump = (op[4] >> 4) == 0x1;
+    if ((op[0] >> 4) == 0x6 && (op[2] >> 4) == 0xa && (op[4] >> 4) == 0xd) {
+        return FUSE_SPRITE;
+    }
+    if ((op[0] >> 4) == 0xf && op[1] == 0x07 && skip_x && jump) {
+        return FUSE_POLL;
+    }
+    if ((op[0] >> 4) == 0x7 && skip_x && jump) {
+        return FUSE_COUNT;
+    }
+    return FUSE_NONE;
+}
+
+/* forgets any superinstruction overlapping the written range */
+static void invalidate(struct chip8 *vm, size_t addr, size_t num)
+{
+    size_t from = (addr > 2 * FUSE_LEN - 1) ? addr - (2 * FUSE_LEN - 1) : 0;
+    size_t to = addr + num;
+    if (to > CHIP8_MEM_SZ) {
+        to = CHIP8_MEM_SZ;
+    }
+    if (from < to) {
+        memset(&vm->fuse[from], FUSE_UNKNOWN, to - from);
+    }
+}
+
+/*
+    XORs an 8xh sprite starting at addr i onto the framebuffer and
+    returns 1 if any lit pixel was turned off. With CHIP8_QUIRK_CLIP
+    only the starting position wraps; pixels past the right or bottom
+    edge are dropped.
+*/
+static uint8_t draw(struct chip8 *vm, uint8_t x, uint8_t y, uint8_t h)
+{
+    uint8_t const *spr = &vm->mem[vm->i];
+    uint8_t changed = 0x0;
+    bool clip = vm->quirks & CHIP8_QUIRK_CLIP;
+    if (clip) {
+        x %= CHIP8_SCREEN_W;
+        y %= CHIP8_SCREEN_H;
+    }
+    size_t xpos = x;
+    for (size_t i = 0; i < h; ++i, xpos = x) {
+        if (clip && y + i >= CHIP8_SCREEN_H) {
+            break;
+        }
+        for (size_t j = SPRITE_W - 1; j < SPRITE_W; --j, ++xpos) {
+            if (clip && xpos >= CHIP8_SCREEN_W) {
                 break;
-            default:
-                goto unrecognized;
-                break;
+            }
+            uint8_t _x = xpos % CHIP8_SCREEN_W;
+            uint8_t _y = (y + i) % CHIP8_SCREEN_H;
+            uint8_t sbit = (spr[i] & (0x1 << j)) >> j;
+            uint8_t vbit = vm->vmem[_y][_x];
+            vm->vmem[_y][_x] = sbit ^ vbit;
+            changed = changed | (sbit & vbit);
         }
-        continue;
-unrecognized:
-        printf("%s: unrecognized opcode: %02x%02x\n", __func__, op_hi, op_lo);
-        chip8_destroy();
-        exit(EXIT_FAILURE);
     }
+    vm->dirty = true;
+    return changed;
+}
+
+/* xorshift32; kept per machine so that runs are reproducible */
+static uint8_t next_rand(struct chip8 *vm)
+{
+    uint32_t r = vm->rng;
+    r ^= r << 13;
+    r ^= r >> 17;
+    r ^= r << 5;
+    vm->rng = r;
+    return r >> 24;
 }
@@ -1,11 +1,62 @@
 /*
-    The Chip8 computer consists of a binary opcode interpreter, screen
-    device, input keypad, and timer subsystem. Each are implemented 
-    (and documented) in their own respective translation units.
-    
-    See chup8.c for a list of Chip8 binary opcodes.
+    The Chip8 computer consists of a binary opcode interpreter, 64x32
+    monochrome framebuffer, 16 key input keypad, and a pair of 60Hz
+    timers. All of it lives in a single struct chip8 so that any number
+    of machines may be embedded in a host program; this translation
+    unit has no dependency on SDL and is built both into the chip8
+    binary and into libchip8.a/libchip8.so.
 
-    Both the init and load functions allow the specification of an
+    See chip8.c for a list of Chip8 binary opcodes.
+
+    A machine is allocated once by chip8_create and never allocates
+    again. chip8_step executes up to n instructions and returns early
+    if the machine halts, faults, or parks on a key wait.
+    chip8_run_frame executes one frame's worth of instructions
+    (cycles_per_frame, 10 by default), ticks both timers once, and
+    calls the draw callback if the framebuffer changed during the frame.
+    Since the timers only ever tick between frames they stay locked to
+    the number of instructions executed, i.e. to emulated rather than
+    wall time, however fast or slowly the host calls chip8_run_frame.
+    Hosts that drive the machine purely through chip8_step are
+    responsible for reading the framebuffer themselves.
+
+    chip8_set_clock replaces cycles_per_frame with a clock rate in Hz.
+    Rates which aren't a multiple of 60 are honoured exactly by carrying
+    the fractional cycle over into later frames (500Hz runs frames of
+    8, 8, 9, 8, 8, 9, ... cycles). A rate of 0 goes back to using
+    cycles_per_frame.
+
+    cycles counts every instruction executed since the machine was
+    created and fused_cycles those which ran as part of a
+    superinstruction (see chip8.c); their ratio is the fusion hit rate.
+    Memory must only be written through chip8_load so that the
+    superinstruction cache stays coherent.
+
+    Programs written for different Chip8 implementations disagree on a
+    handful of opcodes (see chip8.c). A chip8_profile selects the
+    CHIP8_QUIRK_* variants to use along with the cycles_per_frame the
+    program expects (0 meaning the default); chip8_reset leaves the
+    profile alone.
+
+    The framebuffer is CHIP8_SCREEN_H rows of CHIP8_SCREEN_W bytes,
+    each 0 or 1. Drawing over the bottom or right side of the screen
+    simply wraps around to the top or left side, respectively, unless
+    CHIP8_QUIRK_CLIP is set.
+
+    fx0a never blocks. Instead the machine parks in the CHIP8_WAIT
+    state and chip8_step returns straight away; the next key released
+    through chip8_set_key is stored in vx and the machine resumes.
+    While parked, chip8_run_frame still ticks the timers and draws, so
+    a host running in real time can sleep until an input event arrives
+    and a batch host can simply move on to its next machine.
+
+    Callbacks are all optional:
+        draw        called from chip8_run_frame with the framebuffer
+        sound       called with true when the sound timer is started and
+                    false when it runs out or fx18 stops it early
+        key_wait    called when the machine parks on fx0a
+
+    Both the reset and load functions allow the specification of an
     address in Chip8 memory into which to load a program as well as the
     program's entry point, respectively. Please note that most older
     Chip8 programs are hard-coded with address refrences relative to a
@@ -18,14 +69,77 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
-#include <SDL.h>
 
 #define CHIP8_MEM_SZ 4096
 #define CHIP8_STACK_SZ 24
 #define CHIP8_DEFAULT_ENTRY 0x200
+#define CHIP8_NUMREGS 16
+#define CHIP8_NUMKEYS 16
+#define CHIP8_FONTSET_SZ 80
+#define CHIP8_SCREEN_W 64
+#define CHIP8_SCREEN_H 32
+#define CHIP8_DEFAULT_CYCLES 10
+
+#define CHIP8_QUIRK_SHIFT_VY 0x01
+#define CHIP8_QUIRK_LOAD_INC_I 0x02
+#define CHIP8_QUIRK_JUMP_VX 0x04
+#define CHIP8_QUIRK_CLIP 0x08
+
+enum chip8_status {
+    CHIP8_OK = 0,
+    CHIP8_WAIT,
+    CHIP8_HALT,
+    CHIP8_EOPCODE,
+    CHIP8_ESTACK,
+    CHIP8_EMEM
+};
+
+struct chip8_profile {
+    uint8_t quirks;
+    uint16_t cycles_per_frame;
+};
+
+struct chip8_callbacks {
+    void (*draw)(void *, const uint8_t *);
+    void (*sound)(void *, bool);
+    void (*key_wait)(void *);
+    void *ctx;
+};
+
+struct chip8 {
+    uint8_t mem[CHIP8_MEM_SZ + CHIP8_FONTSET_SZ];
+    uint8_t fuse[CHIP8_MEM_SZ];
+    uint8_t vmem[CHIP8_SCREEN_H][CHIP8_SCREEN_W];
+    uint16_t stack[CHIP8_STACK_SZ];
+    uint8_t v[CHIP8_NUMREGS];
+    uint16_t i;
+    uint16_t pc;
+    size_t sp;
+    uint8_t delay;
+    uint8_t sound;
+    uint16_t keys;
+    uint8_t wait_reg;
+    uint32_t rng;
+    uint64_t cycles;
+    uint64_t fused_cycles;
+    uint8_t quirks;
+    size_t cycles_per_frame;
+    uint32_t clock_hz;
+    uint32_t clock_frac;
+    bool dirty;
+    enum chip8_status status;
+    struct chip8_callbacks cb;
+};
 
-void chip8_init(size_t);
-void chip8_reset(void);
-void chip8_destroy(void);
-bool chip8_load(uint16_t, const uint8_t[], size_t);
-void chip8_execute(uint16_t);
\ No newline at end of file
+struct chip8 *chip8_create(const struct chip8_callbacks *);
+void chip8_destroy(struct chip8 *);
+void chip8_reset(struct chip8 *, uint16_t);
+bool chip8_load(struct chip8 *, uint16_t, const uint8_t[], size_t);
+void chip8_set_profile(struct chip8 *, const struct chip8_profile *);
+void chip8_set_clock(struct chip8 *, uint32_t);
+void chip8_seed(struct chip8 *, uint32_t);
+enum chip8_status chip8_step(struct chip8 *, size_t);
+enum chip8_status chip8_run_frame(struct chip8 *);
+const uint8_t *chip8_framebuffer(const struct chip8 *);
+void chip8_set_key(struct chip8 *, uint8_t, bool);
+const char *chip8_strerror(enum chip8_status);
\ No newline at end of file
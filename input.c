@@ -1,8 +1,9 @@
-#include <stdlib.h>
+#include <stdbool.h>
 #include <SDL.h>
 #include "chip8.h"
+#include "stats.h"
 
-#define NUMKEYS 16
+#define NUMKEYS CHIP8_NUMKEYS
 #define KEY_1 SDLK_1
 #define KEY_2 SDLK_2
 #define KEY_3 SDLK_3
@@ -20,63 +21,63 @@
 #define KEY_B SDLK_c
 #define KEY_F SDLK_v
 #define KEY_QUIT SDLK_ESCAPE
+#define KEY_FAST_FORWARD SDLK_TAB
 
 #define CASE_KEY_RETURN(N) \
     case KEY_ ## N:        \
         return 0x ## N
 
-#define QUIT               \
-    chip8_destroy();       \
-    exit(EXIT_SUCCESS)
-
+static bool handle_event(struct chip8 *);
 static uint8_t key_to_num(SDL_Keycode);
 
-static uint16_t Key = 0;
 static SDL_Event E = {0};
+static bool Fast_forward = false;
 
-void input_update()
+bool input_update(struct chip8 *vm)
 {
-    if (SDL_PollEvent(&E)) {
-        if (E.type == SDL_KEYDOWN) {
-            uint8_t keynum = key_to_num(E.key.keysym.sym);
-            if (keynum < NUMKEYS) {
-                Key |= 1 << keynum;
-            }
-        } else if (E.type == SDL_KEYUP) {
-            if (E.key.keysym.sym == KEY_QUIT) {
-                QUIT;
-            }
-            uint8_t keynum = key_to_num(E.key.keysym.sym);
-            if (keynum < NUMKEYS) {
-                Key &= 0 << keynum;
-            }
-        }
-        else if (E.type == SDL_QUIT) {
-            QUIT;
+    while (SDL_PollEvent(&E)) {
+        if (!handle_event(vm)) {
+            return false;
         }
     }
+    return true;
+}
+
+bool input_wait(struct chip8 *vm, int timeout)
+{
+    uint64_t start = stats_now();
+    int got = SDL_WaitEventTimeout(&E, timeout);
+    stats_add(STATS_KEY_WAIT_NS, stats_now() - start);
+    if (got) {
+        return handle_event(vm) && input_update(vm);
+    }
+    return true;
 }
 
-bool input_query(uint8_t key)
+bool input_fast_forward(void)
 {
-    return (Key & 1 << key) ? true : false;
+    return Fast_forward;
 }
 
-uint8_t input_get_key()
+static bool handle_event(struct chip8 *vm)
 {
-    while (SDL_WaitEvent(&E)) {
-        if (E.type == SDL_KEYUP) {
-            uint8_t keynum = key_to_num(E.key.keysym.sym);
-            if (E.key.keysym.sym == KEY_QUIT) {
-                QUIT;
-            } else if (keynum < NUMKEYS) {
-                return keynum;
-            }
-        } else if (E.type == SDL_QUIT) {
-            QUIT;
+    if (E.type == SDL_KEYDOWN) {
+        if (E.key.keysym.sym == KEY_FAST_FORWARD) {
+            Fast_forward = true;
         }
+        chip8_set_key(vm, key_to_num(E.key.keysym.sym), true);
+    } else if (E.type == SDL_KEYUP) {
+        if (E.key.keysym.sym == KEY_QUIT) {
+            return false;
+        } else if (E.key.keysym.sym == KEY_FAST_FORWARD) {
+            Fast_forward = false;
+        }
+        chip8_set_key(vm, key_to_num(E.key.keysym.sym), false);
+    }
+    else if (E.type == SDL_QUIT) {
+        return false;
     }
-    return 0;
+    return true;
 }
 
 static uint8_t key_to_num(SDL_Keycode key) {
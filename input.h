@@ -16,18 +16,23 @@
     values in input.c.
 
     An additional 'quit the program unconditionally` key is provided
-    (Esc by default).
+    (Esc by default); input_update and input_wait return false once it
+    or the window's close button has been pressed. Holding the
+    fast-forward key (Tab by default) makes input_fast_forward return
+    true.
 
     Please note that the input_update function is intended to be run
-    once every Chip8 cycle. The other functions allow one to
-    asynchronosly check whether a specific key or which key, if any,
-    is currently being pressed at the time of the function call.
+    once every frame; it drains all pending events and forwards keypad
+    state to the given machine. input_wait does the same but first
+    sleeps for up to timeout milliseconds until an event arrives, which
+    is how the main program idles while the machine is parked on fx0a.
 */
 #pragma once
 
 #include <stdbool.h>
 #include <stdint.h>
+#include "chip8.h"
 
-void input_update(void);
-bool input_query(uint8_t);
-uint8_t input_get_key(void);
\ No newline at end of file
+bool input_update(struct chip8 *);
+bool input_wait(struct chip8 *, int);
+bool input_fast_forward(void);
\ No newline at end of file
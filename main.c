@@ -1,8 +1,16 @@
 #include <stdio.h>
 #include <unistd.h>
+#include <SDL.h>
 #include "chip8.h"
+#include "input.h"
+#include "romlib.h"
+#include "screen.h"
+#include "stats.h"
+#include "timer.h"
 #include "util.h"
 
+#define FAST_RESERVE_USEC 2000
+
 /* prints "NO PROGRAM\nPRESS ESC" and loops forever */
 static const uint8_t no_prog[] = {
     0x10, 0x2b, 0x90, 0xd0, 0xb0, 0x90, 0x90, 0xe0, 0x90, 0xe0, 0x80, 0x80,
@@ -18,6 +26,49 @@ static const uint8_t no_prog[] = {
     0x1b, 0xf6, 0x29, 0x20, 0x1b, 0xf7, 0x29, 0x20, 0x1b, 0x10, 0x81
 };
 
+/*
+    Drawing only marks the frame for presentation so that the main loop
+    presents at most once per wall-clock frame however many emulated
+    frames it has run, which is what lets fast-forward skip frames.
+*/
+static void draw(void *ctx, uint8_t const fb[])
+{
+    *(bool *)ctx = true;
+}
+
+static enum chip8_status run_frame(struct chip8 *vm)
+{
+    stats_add(STATS_FRAMES, 1);
+    return chip8_run_frame(vm);
+}
+
+/* see chip8.c for what each quirk changes */
+static uint8_t parse_quirks(const char *arg)
+{
+    uint8_t quirks = 0;
+    for (; *arg; ++arg) {
+        switch (*arg) {
+            case 's':
+                quirks |= CHIP8_QUIRK_SHIFT_VY;
+                break;
+            case 'i':
+                quirks |= CHIP8_QUIRK_LOAD_INC_I;
+                break;
+            case 'j':
+                quirks |= CHIP8_QUIRK_JUMP_VX;
+                break;
+            case 'c':
+                quirks |= CHIP8_QUIRK_CLIP;
+                break;
+            case '0':
+                break;
+            default:
+                FAIL("unrecognized quirk");
+        }
+    }
+    return quirks;
+}
+
 int main(int argc, char *argv[argc+1])
 {
     extern char *optarg;
@@ -25,9 +76,19 @@ int main(int argc, char *argv[argc+1])
     int opt = 0;
     size_t scale = 0;
     uint16_t entry = CHIP8_DEFAULT_ENTRY;
-    
+    struct chip8_profile profile = {0};
+    bool have_quirks = false;
+    bool have_cycles = false;
+    const char *index = NULL;
+    const char *index_dir = NULL;
+    struct rom rom = {0};
+    bool verbose = false;
+    const char *stats_path = NULL;
+    uint32_t clock_hz = 0;
+    bool unlimited = false;
+    bool pending = false;
 
-    while ((opt = getopt(argc, argv, ":e:s:")) != -1) {
+    while ((opt = getopt(argc, argv, ":e:s:q:c:f:l:L:m:v")) != -1) {
         switch (opt) {
             case 'e':
                 {
@@ -46,6 +107,44 @@ int main(int argc, char *argv[argc+1])
             case 's':
                 scale = atoi(optarg);
                 break;
+            case 'q':
+                profile.quirks = parse_quirks(optarg);
+                have_quirks = true;
+                break;
+            case 'c':
+                {
+                    long carg = strtol(optarg, NULL, 10);
+                    if (carg <= 0 || carg > UINT16_MAX) {
+                        FAIL("illegal cycles per frame");
+                    }
+                    profile.cycles_per_frame = carg;
+                    have_cycles = true;
+                }
+                break;
+            case 'f':
+                {
+                    char *end = NULL;
+                    long farg = strtol(optarg, &end, 10);
+                    if (end == optarg || *end || farg < 0
+                        || farg > UINT32_MAX) {
+                        FAIL("illegal clock rate");
+                    }
+                    clock_hz = farg;
+                    unlimited = farg == 0;
+                }
+                break;
+            case 'l':
+                index = optarg;
+                break;
+            case 'L':
+                index_dir = optarg;
+                break;
+            case 'm':
+                stats_path = optarg;
+                break;
+            case 'v':
+                verbose = true;
+                break;
             case ':':
                 fprintf(stderr, "Option -%c requires an argument.\n", optopt);
                 goto usage;
@@ -55,35 +154,138 @@ int main(int argc, char *argv[argc+1])
         }
     }
 
-    if (SDL_Init(0) != 0) {
-        FAIL(SDL_GetError());
+    if (index_dir) {
+        if (!romlib_build(index_dir, index, &profile)) {
+            FAIL("unable to index ROM directory");
+        }
+        return EXIT_SUCCESS;
     }
-    atexit(SDL_Quit);
-    chip8_init(scale);
 
+    /*
+        With a ROM library index, the ROM's stored profile is used
+        unless overridden on the command line, in which case the
+        override is also saved for next time if the ROM has been
+        indexed, with a warning if it hasn't. Without an override the
+        index is only ever opened read-only.
+    */
     if (optind < argc) {
-        uint8_t buf[CHIP8_MEM_SZ] = {0};
-        FILE *in = fopen(argv[optind], "rb");
-        size_t bytes_in = fread(
-            buf,
-            sizeof(uint8_t),
-            CHIP8_MEM_SZ - entry,
-            in
-        );
-        // possible off-by-one error
-        if (!feof(in)) {
+        if (!rom_map(&rom, argv[optind])) {
+            FAIL("unable to read input file");
+        }
+        if (rom.size > CHIP8_MEM_SZ - entry) {
             FAIL("input file overflows available program memory");
         }
-        chip8_load(entry, buf, bytes_in);
+        struct romlib lib = {0};
+        struct romlib_entry *e = NULL;
+        bool writable = have_quirks || have_cycles;
+        if (index && !romlib_open(&lib, index, writable)) {
+            FAIL("unable to open ROM library index");
+        }
+        if (index && (e = romlib_find(&lib, rom.hash))) {
+            if (have_quirks) {
+                e->profile.quirks = profile.quirks;
+            }
+            if (have_cycles) {
+                e->profile.cycles_per_frame = profile.cycles_per_frame;
+            }
+            profile = e->profile;
+        } else if (index && writable) {
+            fprintf(stderr, "%s is not in the ROM library index, so its "
+                "settings weren't saved; re-index with -L first.\n",
+                argv[optind]);
+        }
+        romlib_close(&lib);
+    }
+
+    if (SDL_Init(0) != 0) {
+        FAIL(SDL_GetError());
+    }
+    atexit(SDL_Quit);
+    screen_init(scale);
+    timer_init();
+    stats_init(stats_path);
+
+    struct chip8_callbacks cb = {
+        .draw = draw,
+        .ctx = &pending,
+    };
+    struct chip8 *vm = chip8_create(&cb);
+    if (!vm) {
+        FAIL("unable to allocate machine");
+    }
+
+    chip8_set_profile(vm, &profile);
+    chip8_set_clock(vm, clock_hz);
+    if (rom.data) {
+        chip8_reset(vm, entry);
+        chip8_load(vm, entry, rom.data, rom.size);
+        rom_unmap(&rom);
     } else {
-        chip8_load(0, no_prog, sizeof(no_prog));
-        entry = 0;
+        chip8_reset(vm, 0);
+        chip8_load(vm, 0, no_prog, sizeof(no_prog));
+    }
+
+    /*
+        Each pass of the loop is one 60Hz wall-clock frame. Normally it
+        runs the emulated frames which have come due, but while
+        fast-forwarding (or with an unlimited clock) it runs as many as
+        fit before the next wall-clock frame, leaving FAST_RESERVE_USEC
+        to present only the last of them. While the machine is parked
+        on fx0a the loop sleeps in input_wait instead, waking for the
+        next key event or the next frame, whichever comes first, so
+        timers and the screen keep running.
+    */
+    enum chip8_status status = CHIP8_OK;
+    bool quit = false;
+    while (!quit && (status == CHIP8_OK || status == CHIP8_WAIT)) {
+        if (status == CHIP8_WAIT) {
+            quit = !input_wait(vm, (timer_remaining() + 999) / 1000);
+        } else {
+            quit = !input_update(vm);
+        }
+        unsigned due = timer_update();
+        if (status == CHIP8_OK && (unlimited || input_fast_forward())) {
+            do {
+                status = run_frame(vm);
+            } while (status == CHIP8_OK
+                && timer_remaining() > FAST_RESERVE_USEC);
+        } else {
+            for (; due; --due) {
+                status = run_frame(vm);
+                if (status != CHIP8_OK && status != CHIP8_WAIT) {
+                    break;
+                }
+            }
+        }
+        if (pending) {
+            screen_draw(chip8_framebuffer(vm));
+            pending = false;
+        }
+        stats_update(vm);
+        if (status == CHIP8_OK) {
+            timer_wait();
+        }
+    }
+    bool failed = status != CHIP8_OK && status != CHIP8_WAIT
+        && status != CHIP8_HALT;
+    if (failed) {
+        fprintf(stderr, "%03x: (%02x %02x) %s\n", vm->pc, vm->mem[vm->pc],
+            vm->mem[vm->pc + 1], chip8_strerror(status));
+    }
+    stats_write(vm);
+    if (verbose) {
+        fprintf(stderr, "%llu instructions, %.1f%% fused\n",
+            (unsigned long long)vm->cycles,
+            (vm->cycles) ? 100.0 * vm->fused_cycles / vm->cycles : 0.0);
     }
-    chip8_execute(entry);
-    chip8_destroy();
-    return EXIT_SUCCESS;
+    chip8_destroy(vm);
+    screen_destroy();
+    return (failed) ? EXIT_FAILURE : EXIT_SUCCESS;
 usage:
-    printf("Usage: %s [-s scale] [-e entry_point] path/to/chip8/rom\n", 
-            argv[0]);
+    printf("Usage: %s [-v] [-m stats_file] [-s scale] [-e entry_point] "
+            "[-q quirks] [-c cycles] [-f clock_hz] [-l index] "
+            "path/to/chip8/rom\n"
+            "       %s [-q quirks] [-c cycles] [-l index] -L rom_dir\n",
+            argv[0], argv[0]);
     return EXIT_FAILURE;
 }
\ No newline at end of file
@@ -0,0 +1,255 @@
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "romlib.h"
+
+#define INDEX_MAGIC "C8IX"
+#define INDEX_VERSION 1
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+#define ROM_MAX_SZ (CHIP8_MEM_SZ - CHIP8_DEFAULT_ENTRY)
+
+struct header {
+    char magic[4];
+    uint32_t version;
+    uint64_t count;
+};
+
+static int cmp_entry(const void *, const void *);
+static bool write_index(const char *, const struct romlib_entry *, size_t);
+
+uint64_t romlib_hash(uint8_t const data[], size_t num)
+{
+    uint64_t hash = FNV_OFFSET;
+    for (size_t i = 0; i < num; ++i) {
+        hash ^= data[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+bool romlib_build(const char *dir, const char *index,
+    const struct chip8_profile *defaults)
+{
+    char index_path[PATH_MAX] = {0};
+    char path[PATH_MAX] = {0};
+    if (!index) {
+        snprintf(index_path, PATH_MAX, "%s/%s", dir, ROMLIB_INDEX_NAME);
+        index = index_path;
+    }
+
+    DIR *d = opendir(dir);
+    if (!d) {
+        return false;
+    }
+    struct romlib old = {0};
+    bool have_old = romlib_open(&old, index, false);
+    struct romlib_entry *entries = NULL;
+    size_t count = 0;
+    size_t cap = 0;
+    struct dirent *de = NULL;
+    while ((de = readdir(d))) {
+        struct rom rom = {0};
+        if (de->d_name[0] == '.'
+            || strcmp(de->d_name, ROMLIB_INDEX_NAME) == 0) {
+            continue;
+        }
+        snprintf(path, PATH_MAX, "%s/%s", dir, de->d_name);
+        if (strcmp(path, index) == 0) {
+            continue;
+        }
+        if (!rom_map(&rom, path)) {
+            continue;
+        }
+        if (rom.size > ROM_MAX_SZ) {
+            rom_unmap(&rom);
+            continue;
+        }
+        if (count == cap) {
+            cap = (cap) ? cap * 2 : 64;
+            struct romlib_entry *grown = realloc(
+                entries,
+                cap * sizeof(*entries)
+            );
+            if (!grown) {
+                rom_unmap(&rom);
+                goto fail;
+            }
+            entries = grown;
+        }
+        struct romlib_entry *e = &entries[count++];
+        struct romlib_entry *prev = NULL;
+        memset(e, 0, sizeof(*e));
+        e->hash = rom.hash;
+        e->size = rom.size;
+        e->profile = *defaults;
+        if (have_old && (prev = romlib_find(&old, rom.hash))) {
+            e->profile = prev->profile;
+        }
+        size_t len = strlen(de->d_name);
+        memcpy(
+            e->name,
+            de->d_name,
+            (len < ROMLIB_NAME_SZ) ? len : ROMLIB_NAME_SZ - 1
+        );
+        rom_unmap(&rom);
+    }
+    closedir(d);
+    d = NULL;
+    if (have_old) {
+        romlib_close(&old);
+        have_old = false;
+    }
+
+    qsort(entries, count, sizeof(*entries), cmp_entry);
+    size_t uniq = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (!uniq || entries[uniq - 1].hash != entries[i].hash) {
+            entries[uniq++] = entries[i];
+        }
+    }
+    bool ok = write_index(index, entries, uniq);
+    free(entries);
+    return ok;
+fail:
+    if (d) {
+        closedir(d);
+    }
+    if (have_old) {
+        romlib_close(&old);
+    }
+    free(entries);
+    return false;
+}
+
+bool romlib_open(struct romlib *lib, const char *path, bool writable)
+{
+    struct stat st = {0};
+    int fd = open(path, (writable) ? O_RDWR : O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(struct header)) {
+        close(fd);
+        return false;
+    }
+    void *map = mmap(
+        NULL,
+        st.st_size,
+        PROT_READ | ((writable) ? PROT_WRITE : 0),
+        MAP_SHARED,
+        fd,
+        0
+    );
+    close(fd);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    struct header *hdr = map;
+    size_t avail = (st.st_size - sizeof(*hdr)) / sizeof(struct romlib_entry);
+    if (memcmp(hdr->magic, INDEX_MAGIC, sizeof(hdr->magic)) != 0
+        || hdr->version != INDEX_VERSION
+        || hdr->count > avail) {
+        munmap(map, st.st_size);
+        return false;
+    }
+    lib->map = map;
+    lib->map_sz = st.st_size;
+    lib->entries = (struct romlib_entry *)(hdr + 1);
+    lib->count = hdr->count;
+    return true;
+}
+
+void romlib_close(struct romlib *lib)
+{
+    if (lib->map) {
+        munmap(lib->map, lib->map_sz);
+    }
+    *lib = (struct romlib){0};
+}
+
+struct romlib_entry *romlib_find(const struct romlib *lib, uint64_t hash)
+{
+    size_t lo = 0;
+    size_t hi = lib->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (lib->entries[mid].hash < hash) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo < lib->count && lib->entries[lo].hash == hash) {
+        return &lib->entries[lo];
+    }
+    return NULL;
+}
+
+bool rom_map(struct rom *rom, const char *path)
+{
+    struct stat st = {0};
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    rom->data = map;
+    rom->size = st.st_size;
+    rom->hash = romlib_hash(rom->data, rom->size);
+    return true;
+}
+
+void rom_unmap(struct rom *rom)
+{
+    if (rom->data) {
+        munmap((void *)rom->data, rom->size);
+    }
+    *rom = (struct rom){0};
+}
+
+static int cmp_entry(const void *a, const void *b)
+{
+    uint64_t ha = ((const struct romlib_entry *)a)->hash;
+    uint64_t hb = ((const struct romlib_entry *)b)->hash;
+    return (ha > hb) - (ha < hb);
+}
+
+/* written alongside and renamed into place so readers never see half */
+static bool write_index(const char *path, 
+    const struct romlib_entry *entries, size_t count)
+{
+    char tmp[PATH_MAX] = {0};
+    struct header hdr = {
+        .magic = INDEX_MAGIC,
+        .version = INDEX_VERSION,
+        .count = count,
+    };
+    snprintf(tmp, PATH_MAX, "%s.tmp", path);
+    FILE *out = fopen(tmp, "wb");
+    if (!out) {
+        return false;
+    }
+    bool ok = fwrite(&hdr, sizeof(hdr), 1, out) == 1
+        && fwrite(entries, sizeof(*entries), count, out) == count;
+    ok = (fclose(out) == 0) && ok;
+    if (!ok || rename(tmp, path) != 0) {
+        unlink(tmp);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,61 @@
+/*
+    A ROM library is a directory of Chip8 programs together with a
+    compact on-disk index of them, keyed by a 64-bit FNV-1a hash of each
+    program's contents. Each index entry records the program's size,
+    file name, and the chip8_profile (quirks and cycles per frame) it
+    should be run with, so a program only needs to be configured once
+    no matter what it is called or where it is copied.
+
+    romlib_build scans a directory and writes its index (by default
+    ROMLIB_INDEX_NAME inside that directory), keeping the profile of
+    any program already present in an existing index and giving new
+    ones the supplied default. The index is an array of fixed-size
+    entries sorted by hash behind a small header, written in host byte
+    order.
+
+    romlib_open maps an index into memory; romlib_find looks a hash up
+    by binary search and returns the entry in place, so that when the
+    index was opened writable a profile can be updated simply by
+    assigning to it; the mapping is shared, so the change is written
+    through to the file.
+
+    rom_map maps a single program read-only and hashes it. The mapping
+    can be handed straight to chip8_load.
+*/
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "chip8.h"
+
+#define ROMLIB_INDEX_NAME "chip8.idx"
+#define ROMLIB_NAME_SZ 48
+
+struct romlib_entry {
+    uint64_t hash;
+    uint16_t size;
+    struct chip8_profile profile;
+    char name[ROMLIB_NAME_SZ];
+};
+
+struct romlib {
+    void *map;
+    size_t map_sz;
+    struct romlib_entry *entries;
+    size_t count;
+};
+
+struct rom {
+    const uint8_t *data;
+    size_t size;
+    uint64_t hash;
+};
+
+uint64_t romlib_hash(const uint8_t[], size_t);
+bool romlib_build(const char *, const char *, const struct chip8_profile *);
+bool romlib_open(struct romlib *, const char *, bool);
+void romlib_close(struct romlib *);
+struct romlib_entry *romlib_find(const struct romlib *, uint64_t);
+bool rom_map(struct rom *, const char *);
+void rom_unmap(struct rom *);
\ No newline at end of file
@@ -1,12 +1,11 @@
 #include <stdbool.h>
 #include <SDL.h>
+#include "chip8.h"
 #include "screen.h"
+#include "stats.h"
 #include "util.h"
 
-#define SPRITE_W 8
-#define SCREEN_W 64
 #define SCREEN_W_EXP 6
-#define SCREEN_H 32
 #define SCREEN_H_EXP 5
 #define DEFAULT_BG {0x00, 0x00, 0x00, 0xff}
 #define DEFAULT_FG {0xff, 0xff, 0xff, 0xff}
@@ -14,7 +13,6 @@
 
 #define SET_COLOR(C) SDL_SetRenderDrawColor(Ren, C[0], C[1], C[2], C[3])
 
-static bool Vmem[SCREEN_H][SCREEN_W] = {0};
 static SDL_Window *Win = 0;
 static SDL_Renderer *Ren = 0;
 static size_t Px_scale = 0;
@@ -51,42 +49,14 @@ void screen_init(size_t scale)
     SDL_RenderPresent(Ren);
 }
 
-void screen_cls(void)
+void screen_draw(uint8_t const fb[])
 {
-    for (size_t i = 0; i < SCREEN_H; ++i) {
-        for (size_t j = 0; j < SCREEN_W; ++j) {
-            Vmem[i][j] = false;
-        }
-    }
-    if (Ren) {
-        SET_COLOR(Bg);
-        SDL_RenderClear(Ren);
-        SDL_RenderPresent(Ren);
-    }
-}
-
-uint8_t screen_draw(uint8_t x, uint8_t y, uint8_t h, uint8_t const spr[h])
-{
-    if (Ren) {
-        SET_COLOR(Bg);
-        SDL_RenderClear(Ren);
-    }
-    uint8_t changed = 0x0;
-    size_t xpos = x;
-    for (size_t i = 0; i < h; ++i, xpos = x) {
-        for (size_t j = SPRITE_W - 1; j < SPRITE_W; --j, ++xpos) {
-            uint8_t _x = xpos % SCREEN_W;
-            uint8_t _y = (y + i) % SCREEN_H;
-            uint8_t sbit = (spr[i] & (0x1 << j)) >> j;
-            uint8_t vbit = Vmem[_y][_x];
-            Vmem[_y][_x] = sbit ^ vbit;
-            changed = changed | (sbit & vbit);
-        }
-    }
+    SET_COLOR(Bg);
+    SDL_RenderClear(Ren);
     SET_COLOR(Fg);
-    for (size_t i = 0; i < SCREEN_H; ++i) {
-        for (size_t j = 0; j < SCREEN_W; ++j) {
-            if (Vmem[i][j]) {
+    for (size_t i = 0; i < CHIP8_SCREEN_H; ++i) {
+        for (size_t j = 0; j < CHIP8_SCREEN_W; ++j) {
+            if (fb[i * CHIP8_SCREEN_W + j]) {
                 SDL_Rect r = {
                     .x = j * PX_SZ,
                     .y = i * PX_SZ,
@@ -97,8 +67,10 @@ uint8_t screen_draw(uint8_t x, uint8_t y, uint8_t h, uint8_t const spr[h])
             }
         }
     }
+    uint64_t start = stats_now();
     SDL_RenderPresent(Ren);
-    return changed;
+    stats_add(STATS_PRESENT_NS, stats_now() - start);
+    stats_add(STATS_PRESENTS, 1);
 }
 
 void screen_destroy(void)
@@ -0,0 +1,139 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+#include "stats.h"
+
+#define NSEC 1000000000ULL
+
+struct metric {
+    const char *name;
+    const char *help;
+};
+
+static const struct metric counters[STATS_NUM_COUNTERS] = {
+    [STATS_FRAMES] = {
+        "chip8_frames_total",
+        "Emulated 60Hz frames run."
+    },
+    [STATS_PRESENTS] = {
+        "chip8_frames_presented_total",
+        "Frames presented to the screen."
+    },
+    [STATS_PRESENT_NS] = {
+        "chip8_present_seconds_total",
+        "Time spent blocked in SDL_RenderPresent."
+    },
+    [STATS_KEY_WAIT_NS] = {
+        "chip8_key_wait_seconds_total",
+        "Time spent parked waiting for a key (fx0a)."
+    },
+    [STATS_TIMER_DRIFT_NS] = {
+        "chip8_timer_drift_seconds_total",
+        "Time by which frames were started later than they were due."
+    },
+    [STATS_TIMER_DROPPED] = {
+        "chip8_timer_frames_dropped_total",
+        "Frames skipped because the host fell too far behind."
+    },
+};
+
+static uint64_t Counters[STATS_NUM_COUNTERS] = {0};
+static const char *Path = NULL;
+static uint64_t Start = 0;
+static uint64_t Next_write = 0;
+static uint64_t Prev_write = 0;
+static uint64_t Prev_cycles = 0;
+
+static inline bool is_time(enum stats_counter);
+
+void stats_init(const char *path)
+{
+    Path = path;
+    Start = stats_now();
+    Prev_write = Start;
+    Next_write = Start + STATS_INTERVAL_SEC * NSEC;
+}
+
+uint64_t stats_now(void)
+{
+    struct timespec ts = {0};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * NSEC + ts.tv_nsec;
+}
+
+void stats_add(enum stats_counter c, uint64_t val)
+{
+    Counters[c] += val;
+}
+
+void stats_update(const struct chip8 *vm)
+{
+    if (Path && stats_now() >= Next_write) {
+        stats_write(vm);
+    }
+}
+
+void stats_write(const struct chip8 *vm)
+{
+    char tmp[FILENAME_MAX] = {0};
+    if (!Path) {
+        return;
+    }
+    uint64_t now = stats_now();
+    double interval = (double)(now - Prev_write) / NSEC;
+    double rate = (interval > 0) ? (vm->cycles - Prev_cycles) / interval : 0;
+    Prev_write = now;
+    Prev_cycles = vm->cycles;
+    Next_write = now + STATS_INTERVAL_SEC * NSEC;
+
+    snprintf(tmp, sizeof(tmp), "%s.tmp", Path);
+    FILE *out = fopen(tmp, "w");
+    if (!out) {
+        return;
+    }
+    fprintf(out,
+        "# HELP chip8_instructions_total Instructions executed.\n"
+        "# TYPE chip8_instructions_total counter\n"
+        "chip8_instructions_total %llu\n"
+        "# HELP chip8_fused_instructions_total Instructions executed as "
+            "part of a superinstruction.\n"
+        "# TYPE chip8_fused_instructions_total counter\n"
+        "chip8_fused_instructions_total %llu\n"
+        "# HELP chip8_instructions_per_second Instruction rate over the "
+            "last interval.\n"
+        "# TYPE chip8_instructions_per_second gauge\n"
+        "chip8_instructions_per_second %.0f\n"
+        "# HELP chip8_waiting_for_key Whether the machine is parked on "
+            "fx0a.\n"
+        "# TYPE chip8_waiting_for_key gauge\n"
+        "chip8_waiting_for_key %d\n"
+        "# HELP chip8_uptime_seconds Time since start.\n"
+        "# TYPE chip8_uptime_seconds gauge\n"
+        "chip8_uptime_seconds %.3f\n",
+        (unsigned long long)vm->cycles,
+        (unsigned long long)vm->fused_cycles,
+        rate,
+        vm->status == CHIP8_WAIT,
+        (double)(now - Start) / NSEC
+    );
+    for (size_t c = 0; c < STATS_NUM_COUNTERS; ++c) {
+        fprintf(out, "# HELP %s %s\n# TYPE %s counter\n",
+            counters[c].name, counters[c].help, counters[c].name);
+        if (is_time(c)) {
+            fprintf(out, "%s %.6f\n", counters[c].name,
+                (double)Counters[c] / NSEC);
+        } else {
+            fprintf(out, "%s %llu\n", counters[c].name,
+                (unsigned long long)Counters[c]);
+        }
+    }
+    if (fclose(out) != 0 || rename(tmp, Path) != 0) {
+        remove(tmp);
+    }
+}
+
+static inline bool is_time(enum stats_counter c)
+{
+    return c == STATS_PRESENT_NS || c == STATS_KEY_WAIT_NS
+        || c == STATS_TIMER_DRIFT_NS;
+}
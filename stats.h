@@ -0,0 +1,39 @@
+/*
+    Runtime metrics for the main program. Counters are plain integers
+    bumped at most a few times per frame, cheap enough to leave on
+    permanently; the per-instruction counts come from the machine
+    itself (see chip8.h).
+
+    stats_add accumulates into a counter and stats_now reads the
+    monotonic clock in nanoseconds for timing the places where the
+    program can stall: presenting a frame, waiting on a key for fx0a,
+    and timer_update noticing a frame later than it was due.
+
+    If stats_init was given a path, stats_update rewrites that file
+    every STATS_INTERVAL_SEC in the Prometheus text exposition format,
+    replacing it atomically so that a scraper (or a textfile collector)
+    never sees a partial write. stats_write forces a rewrite, e.g. on
+    exit.
+*/
+#pragma once
+
+#include <stdint.h>
+#include "chip8.h"
+
+#define STATS_INTERVAL_SEC 1
+
+enum stats_counter {
+    STATS_FRAMES,
+    STATS_PRESENTS,
+    STATS_PRESENT_NS,
+    STATS_KEY_WAIT_NS,
+    STATS_TIMER_DRIFT_NS,
+    STATS_TIMER_DROPPED,
+    STATS_NUM_COUNTERS
+};
+
+void stats_init(const char *);
+uint64_t stats_now(void);
+void stats_add(enum stats_counter, uint64_t);
+void stats_update(const struct chip8 *);
+void stats_write(const struct chip8 *);
\ No newline at end of file
@@ -1,54 +1,91 @@
 #include <stddef.h>
 #include <sys/time.h>
+#include <unistd.h>
+#include "stats.h"
 #include "timer.h"
 
-static uint8_t Delay = 0;
-static uint8_t Sound = 0;
+#define FRAME_HZ 60
+#define FRAME_USEC (1000000 / FRAME_HZ)
+#define FRAME_FRAC (1000000 % FRAME_HZ)
+#define MAX_BACKLOG 4
+
 static struct timeval Prevtime = {0};
 static struct timeval Currtime = {0};
+static long Frac = 0;
 
 static inline long timediff(struct timeval *, struct timeval *);
+static inline void advance(struct timeval *, long);
+static inline long frame_len(void);
 
 void timer_init()
 {
     gettimeofday(&Prevtime, NULL);
 }
 
-void timer_update()
+/*
+    Prevtime is advanced by whole frames rather than snapped to the
+    current time, and since a frame isn't a whole number of
+    microseconds the remainder is carried in Frac (in 1/60ths of a
+    microsecond) so that frames average exactly 1/60s. If the
+    host falls badly behind, the backlog is dropped instead of being
+    run in a burst. How late each frame is noticed is recorded as
+    timer drift (see stats.h).
+*/
+unsigned timer_update()
 {
     gettimeofday(&Currtime, NULL);
-    if (timediff(&Prevtime, &Currtime) >= 16666) {
-        Delay -= (Delay) ? 1 : 0;
-        Sound -= (Sound) ? 1 : 0;
-        Prevtime.tv_usec = Currtime.tv_usec;
-        Prevtime.tv_sec = Currtime.tv_sec;
+    long elapsed = timediff(&Prevtime, &Currtime);
+    long frames = elapsed / FRAME_USEC;
+    if (frames > MAX_BACKLOG) {
+        stats_add(STATS_TIMER_DRIFT_NS, (elapsed - FRAME_USEC) * 1000);
+        stats_add(STATS_TIMER_DROPPED, frames - 1);
+        Prevtime = Currtime;
+        return 1;
+    }
+    frames = 0;
+    for (long len = frame_len(); elapsed >= len; len = frame_len()) {
+        elapsed -= len;
+        advance(&Prevtime, len);
+        Frac = (Frac + FRAME_FRAC) % FRAME_HZ;
+        ++frames;
     }
+    if (frames) {
+        stats_add(STATS_TIMER_DRIFT_NS, elapsed * 1000);
+    }
+    return frames;
 }
 
-void timer_set_delay(uint8_t val)
+long timer_remaining()
 {
-    Delay = val;
+    gettimeofday(&Currtime, NULL);
+    long remaining = frame_len() - timediff(&Prevtime, &Currtime);
+    return (remaining > 0) ? remaining : 0;
 }
 
-uint8_t timer_get_delay()
+void timer_wait()
 {
-    return Delay;
+    long remaining = timer_remaining();
+    if (remaining > 0) {
+        usleep(remaining);
+    }
 }
 
-void timer_set_sound(uint8_t val)
+static inline long timediff(struct timeval *before, struct timeval *after)
 {
-    Sound = val;
+    long diff = 0;
+    diff = after->tv_sec * 1000000 + after->tv_usec;
+    diff -= before->tv_sec * 1000000 + before->tv_usec;
+    return diff;
 }
 
-uint8_t timer_get_sound()
+static inline void advance(struct timeval *tv, long usec)
 {
-    return Sound;
+    usec += tv->tv_usec;
+    tv->tv_sec += usec / 1000000;
+    tv->tv_usec = usec % 1000000;
 }
 
-static inline long timediff(struct timeval *before, struct timeval *after)
+static inline long frame_len()
 {
-    long diff = 0;
-    diff = after->tv_sec * 1000000 + after->tv_usec;
-    diff -= before->tv_sec * 1000000 + before->tv_usec;
-    return diff;
+    return FRAME_USEC + (Frac + FRAME_FRAC >= FRAME_HZ);
 }
\ No newline at end of file
@@ -1,21 +1,17 @@
 /*
-    Chip8's timer system includes a general purpose timer and a sound
-    timer that produces an audible beep when it ticks down to zero.
-    As implemented, instead of making what would almost assuredly be
-    an extremey annoying ruckus, the default behavior is just to notify
-    the user via STDOUT that a sound event has occured.
+    The Chip8 delay and sound timers themselves live in the machine
+    (see chip8.h) and tick once per chip8_run_frame. This module only
+    paces the main program against the wall clock: timer_update returns
+    the number of 60Hz frames which have come due since it was last
+    called, timer_remaining returns the microseconds until the next one
+    does, and timer_wait sleeps for that long.
 
     In order to function properly, timer_init needs to be called
-    before any calls to timer_update. The timer_update function is
-    intended to be run once per Chip8 cycle.
+    before any calls to timer_update.
 */
 #pragma once
 
-#include <stdint.h>
-
 void timer_init(void);
-void timer_update(void);
-void timer_set_delay(uint8_t);
-uint8_t timer_get_delay(void);
-void timer_set_sound(uint8_t);
-uint8_t timer_get_sound(void);
\ No newline at end of file
+unsigned timer_update(void);
+long timer_remaining(void);
+void timer_wait(void);
\ No newline at end of file